@@ -0,0 +1,83 @@
+//! @brief Counts the heap allocations of the whole process by interposing
+//! the glibc malloc family, so that allocations of Eigen (malloc) and of
+//! the standard library (operator new) are both seen.
+//!
+//! Include it in exactly one translation unit of an executable. Without
+//! glibc, nothing is counted and `allocations::Enabled()` is false.
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+
+namespace allocations
+{
+inline std::atomic<long>& Counter()
+{
+    static std::atomic<long> count{0};
+    return count;
+}
+
+//! @brief number of allocations since the start of the process
+inline long Count()
+{
+    return Counter().load(std::memory_order_relaxed);
+}
+
+#ifdef __GLIBC__
+constexpr bool Enabled()
+{
+    return true;
+}
+#else
+constexpr bool Enabled()
+{
+    return false;
+}
+#endif
+} // namespace allocations
+
+#ifdef __GLIBC__
+extern "C"
+{
+    void* __libc_malloc(std::size_t size);
+    void* __libc_calloc(std::size_t n, std::size_t size);
+    void* __libc_realloc(void* memory, std::size_t size);
+    void* __libc_memalign(std::size_t alignment, std::size_t size);
+
+    void* malloc(std::size_t size) noexcept
+    {
+        allocations::Counter().fetch_add(1, std::memory_order_relaxed);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(std::size_t n, std::size_t size) noexcept
+    {
+        allocations::Counter().fetch_add(1, std::memory_order_relaxed);
+        return __libc_calloc(n, size);
+    }
+
+    void* realloc(void* memory, std::size_t size) noexcept
+    {
+        allocations::Counter().fetch_add(1, std::memory_order_relaxed);
+        return __libc_realloc(memory, size);
+    }
+
+    void* memalign(std::size_t alignment, std::size_t size) noexcept
+    {
+        allocations::Counter().fetch_add(1, std::memory_order_relaxed);
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(std::size_t alignment, std::size_t size) noexcept
+    {
+        return memalign(alignment, size);
+    }
+
+    int posix_memalign(void** memory, std::size_t alignment, std::size_t size) noexcept
+    {
+        *memory = memalign(alignment, size);
+        return *memory ? 0 : ENOMEM;
+    }
+}
+#endif
@@ -0,0 +1,124 @@
+"""
+Performance regression check
+============================
+
+Converts the JSON output of ``benchmark_laws`` into one record per
+benchmark::
+
+    {"benchmark": "IpLoop/LocalDamage/PLANE_STRAIN/1000", "law": "LocalDamage",
+     "constraint": "PLANE_STRAIN", "ips": 1000, "threads": 1,
+     "ns_per_ip": 231.2, "bytes_per_ip": 96.0, "allocations": 7001.0}
+
+and compares them to the records of ``baseline.json``::
+
+    ./benchmark_laws --benchmark_filter='/(1000|100000)$' \\
+                     --benchmark_out=run.json --benchmark_out_format=json
+    python3 benchmarks/compare.py run.json
+    python3 benchmarks/compare.py run.json --save  # new baseline
+
+``benchmark_laws --threads=4`` evaluates the IpLoop benchmarks with four
+threads. Their names then contain ``threads:4``, so they get their own
+records and baseline entries.
+
+``benchmark_scaling --json scaling.json`` writes such records directly, they
+are compared the same way, e.g. against ``--baseline scaling_baseline.json``.
+
+A benchmark regresses if it got slower than ``--tolerance`` (relative) or
+if it needs more bytes or allocations than before. Then, the script exits
+with 1. The baseline is only meaningful for the machine it was recorded on,
+so record one before changing a hot path and compare against it after.
+"""
+
+import argparse
+import json
+import pathlib
+import sys
+
+BASELINE = pathlib.Path(__file__).parent / "baseline.json"
+
+
+def records(output):
+    """
+    Records from the google benchmark JSON `output`. With repetitions, the
+    median of each benchmark is used. A list, e.g. the output of
+    benchmark_scaling, already holds the records.
+    """
+    if isinstance(output, list):
+        return {record["benchmark"]: record for record in output}
+
+    runs = output["benchmarks"]
+    if any(run.get("aggregate_name") == "median" for run in runs):
+        runs = [run for run in runs if run.get("aggregate_name") == "median"]
+    else:
+        runs = [run for run in runs if run.get("run_type", "iteration") == "iteration"]
+
+    result = {}
+    for run in runs:
+        name = run.get("run_name", run["name"])
+        # The IpLoop threads are part of the name, e.g. ".../threads:4/1000".
+        # Google benchmark's own "threads" field counts the threads running
+        # the benchmark function, that is always 1.
+        parts = name.split("/")
+        threads = [int(part.split(":")[1]) for part in parts if part.startswith("threads:")]
+        kind, law, *rest = [part for part in parts if not part.startswith("threads:")]
+        result[name] = {
+            "benchmark": name,
+            "law": law,
+            "constraint": rest[0] if len(rest) == 2 else None,
+            "ips": int(rest[-1]),
+            "threads": threads[0] if threads else 1,
+            "ns_per_ip": run["time/IP"] * 1.0e9,
+            "bytes_per_ip": run["bytes/IP"],
+            "allocations": run["allocations"],
+        }
+    return result
+
+
+def regressions(baseline, current, tolerance):
+    """
+    Messages for all regressions of `current` with respect to `baseline`,
+    both {name: record}.
+    """
+    messages = []
+    for name, now in sorted(current.items()):
+        before = baseline.get(name)
+        if before is None:
+            continue
+        if now["ns_per_ip"] > (1.0 + tolerance) * before["ns_per_ip"]:
+            messages.append(f"{name}: {before['ns_per_ip']:.1f} -> {now['ns_per_ip']:.1f} ns/IP")
+        for key in ["bytes_per_ip", "allocations"]:
+            if now[key] > before[key]:
+                messages.append(f"{name}: {before[key]:g} -> {now[key]:g} {key}")
+    return messages
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("output", help="JSON output of benchmark_laws or benchmark_scaling")
+    parser.add_argument("--baseline", default=str(BASELINE))
+    parser.add_argument("--tolerance", type=float, default=0.1, help="relative slowdown that is accepted")
+    parser.add_argument("--save", action="store_true", help="write the records as the new baseline")
+    args = parser.parse_args()
+
+    with open(args.output) as f:
+        current = records(json.load(f))
+
+    if args.save:
+        with open(args.baseline, "w") as f:
+            json.dump(sorted(current.values(), key=lambda r: r["benchmark"]), f, indent=1)
+            f.write("\n")
+        return 0
+
+    with open(args.baseline) as f:
+        baseline = {record["benchmark"]: record for record in json.load(f)}
+
+    messages = regressions(baseline, current, args.tolerance)
+    for message in messages:
+        print(message)
+    missing = len([name for name in current if name not in baseline])
+    print(f"{len(current)} benchmarks, {len(messages)} regressions, {missing} without baseline")
+    return 1 if messages else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
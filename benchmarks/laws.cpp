@@ -0,0 +1,275 @@
+//! @brief Per-IP throughput of the laws and their building blocks for all
+//! constraints. "IpLoop/..." evaluates a law through an `IpLoop`,
+//! "Direct/..." calls it IP by IP without one, so the difference is the
+//! dispatch overhead of the loop. "IpLoop/AutoDiff..." derives the tangents of
+//! the damage laws by automatic differentiation, see autodiff.h.
+//!
+//! Run e.g. `./benchmark_laws --benchmark_filter=LocalDamage/PLANE_STRAIN`.
+//! `--threads=N` evaluates the "IpLoop/..." benchmarks with N threads, see
+//! `IpLoop::SetNumThreads`. Then, their names contain "threads:N", e.g.
+//! "IpLoop/LocalDamage/FULL/threads:4/1000".
+//!
+//! Besides the time per IP, each benchmark reports the bytes per IP of its
+//! inputs, outputs and histories and the heap allocations per pass over
+//! all IPs. See compare.py for the regression check of the JSON output.
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include "allocations.h"
+#include "autodiff.h"
+#include "linear_elastic.h"
+#include "local_damage.h"
+#include "plasticity.h"
+
+namespace
+{
+const std::vector<std::pair<Constraint, std::string>> constraints = {{UNIAXIAL_STRAIN, "UNIAXIAL_STRAIN"},
+                                                                     {UNIAXIAL_STRESS, "UNIAXIAL_STRESS"},
+                                                                     {PLANE_STRAIN, "PLANE_STRAIN"},
+                                                                     {PLANE_STRESS, "PLANE_STRESS"},
+                                                                     {FULL, "FULL"}};
+
+// damage starts at k0 = 1e-4 and the strains are of the order of 1e-3, so
+// most IPs are damaged, some are not
+const double youngs_modulus = 20000., nu = 0.2, k0 = 1.e-4;
+
+//! @brief threads of the `IpLoop` benchmarks, see `--threads`
+int num_threads = 1;
+
+std::shared_ptr<DamageLawExponential> Omega()
+{
+    return std::make_shared<DamageLawExponential>(k0, 0.99, 100.);
+}
+
+std::shared_ptr<ModMisesEeq> Norm(Constraint c)
+{
+    return std::make_shared<ModMisesEeq>(10., nu, c);
+}
+
+Eigen::VectorXd RandomStrains(int n, Constraint c)
+{
+    return 1.e-3 * Eigen::VectorXd::Random(static_cast<Eigen::Index>(n) * Dim::Q(c));
+}
+
+std::size_t HistoryBytes(LawInterface& law)
+{
+    std::size_t bytes = 0;
+    for (const QValues* history : law.History())
+        bytes += history->Bytes();
+    return bytes;
+}
+
+std::size_t HistoryBytes(MechanicsLaw& law)
+{
+    std::size_t bytes = 0;
+    for (const QValues* history : law.History())
+        bytes += history->Bytes();
+    return bytes;
+}
+
+//! @brief Counts the allocations and the wall time from construction to
+//! `Record`, i.e. in the benchmark loop. The CPU time of the main thread
+//! would miss the work of the other threads with `--threads`.
+class Record
+{
+public:
+    Record()
+        : _allocations(allocations::Count())
+        , _start(std::chrono::steady_clock::now())
+    {
+    }
+
+    void operator()(benchmark::State& state, int n, std::size_t bytes) const
+    {
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+        const double ips = static_cast<double>(state.iterations()) * n;
+        const double allocated = static_cast<double>(allocations::Count() - _allocations);
+        state.SetItemsProcessed(static_cast<int64_t>(ips));
+        state.counters["time/IP"] = seconds / ips;
+        state.counters["bytes/IP"] = static_cast<double>(bytes) / n;
+        state.counters["allocations"] = benchmark::Counter(allocated, benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    long _allocations;
+    std::chrono::steady_clock::time_point _start;
+};
+
+//! @brief evaluates `law` for state.range(0) IPs through an `IpLoop`
+template <typename TLaw>
+void ThroughIpLoop(benchmark::State& state, std::shared_ptr<TLaw> law, Constraint c)
+{
+    const int n = state.range(0);
+    IpLoop loop;
+    loop.SetNumThreads(num_threads);
+    loop.AddLaw(law, {});
+    loop.Resize(n);
+
+    // Set the inputs once, such that only the material pass is measured.
+    const Eigen::VectorXd strains = RandomStrains(n, c);
+    loop.Evaluate(strains, 0.5 * strains.head(n).cwiseAbs());
+
+    Record record;
+    for (auto _ : state)
+    {
+        loop.Evaluate();
+        benchmark::ClobberMemory();
+    }
+    record(state, n, loop.Bytes());
+}
+
+//! @brief calls `law` IP by IP via `EvaluateTo`, as the `IpLoop` does
+void DirectMechanicsLaw(benchmark::State& state, std::shared_ptr<MechanicsLaw> law, Constraint c)
+{
+    const int n = state.range(0);
+    const int q = Dim::Q(c);
+    law->Resize(n);
+    const Eigen::VectorXd strains = RandomStrains(n, c);
+    VectorQ strain(q), stress(q);
+    MatrixQ tangent(q, q);
+    // History() returns a vector, so this allocates outside of the record
+    const std::size_t bytes = strains.size() * sizeof(double) + HistoryBytes(*law);
+
+    Record record;
+    for (auto _ : state)
+        for (int i = 0; i < n; ++i)
+        {
+            strain = strains.segment(q * i, q);
+            law->EvaluateTo(strain, stress, tangent, i);
+            benchmark::DoNotOptimize(stress.data());
+            benchmark::DoNotOptimize(tangent.data());
+        }
+    record(state, n, bytes);
+}
+
+void DirectGradientDamage(benchmark::State& state, Constraint c)
+{
+    const int n = state.range(0);
+    GradientDamage law(youngs_modulus, nu, c, Omega(), Norm(c));
+    std::vector<QValues> inputs(Q::LAST), outputs(Q::LAST);
+    law.DefineInputs(inputs);
+    law.DefineOutputs(outputs);
+    for (auto* qs : {&inputs, &outputs})
+        for (auto& values : *qs)
+            if (values.IsUsed())
+                values.Resize(n);
+    law.Resize(n);
+
+    const Eigen::VectorXd strains = RandomStrains(n, c);
+    inputs[EPS].SetValues(strains);
+    inputs[E].SetValues(0.5 * strains.head(n).cwiseAbs());
+
+    std::size_t bytes = HistoryBytes(law);
+    for (const auto* qs : {&inputs, &outputs})
+        for (const auto& values : *qs)
+            bytes += values.Bytes();
+
+    Record record;
+    for (auto _ : state)
+    {
+        for (int i = 0; i < n; ++i)
+            law.Evaluate(inputs, outputs, i);
+        benchmark::ClobberMemory();
+    }
+    record(state, n, bytes);
+}
+
+std::pair<double, Eigen::VectorXd> Call(const ModMisesEeq& norm, const Eigen::VectorXd& strain)
+{
+    return norm.Evaluate(strain);
+}
+
+std::pair<double, Eigen::VectorXd> Call(const NormVM& norm, const Eigen::VectorXd& strain)
+{
+    return norm.Call(strain);
+}
+
+template <typename TNorm>
+void DirectNorm(benchmark::State& state, const TNorm& norm, Constraint c)
+{
+    const int n = state.range(0);
+    const int q = Dim::Q(c);
+    const Eigen::VectorXd strains = RandomStrains(n, c);
+    Eigen::VectorXd strain(q);
+
+    Record record;
+    for (auto _ : state)
+        for (int i = 0; i < n; ++i)
+        {
+            strain = strains.segment(q * i, q);
+            benchmark::DoNotOptimize(Call(norm, strain));
+        }
+    record(state, n, strains.size() * sizeof(double));
+}
+
+void DirectDamageLaw(benchmark::State& state)
+{
+    const int n = state.range(0);
+    const Eigen::VectorXd kappas = 2.e-3 * Eigen::VectorXd::Random(n).cwiseAbs();
+    const auto omega = Omega();
+
+    Record record;
+    for (auto _ : state)
+        for (int i = 0; i < n; ++i)
+            benchmark::DoNotOptimize(omega->Evaluate(kappas[i]));
+    record(state, n, kappas.size() * sizeof(double));
+}
+
+void Register(const std::string& name, std::function<void(benchmark::State&)> f)
+{
+    benchmark::RegisterBenchmark(name.c_str(), f)->RangeMultiplier(10)->Range(1000, 10000000)->Unit(
+            benchmark::kMillisecond);
+}
+
+void RegisterAll()
+{
+    for (const auto& constraint : constraints)
+    {
+        const Constraint c = constraint.first;
+        const std::string& name = constraint.second;
+        // the direct benchmarks always run serially
+        const std::string loop_name = num_threads == 1 ? name : name + "/threads:" + std::to_string(num_threads);
+
+        auto elastic = [c]() { return std::make_shared<LinearElastic>(youngs_modulus, nu, c); };
+        auto local = [c]() { return std::make_shared<LocalDamage>(youngs_modulus, nu, c, Omega(), Norm(c)); };
+        auto gradient = [c]() { return std::make_shared<GradientDamage>(youngs_modulus, nu, c, Omega(), Norm(c)); };
+
+        Register("IpLoop/LinearElastic/" + loop_name, [=](benchmark::State& s) { ThroughIpLoop(s, elastic(), c); });
+        Register("IpLoop/LocalDamage/" + loop_name, [=](benchmark::State& s) { ThroughIpLoop(s, local(), c); });
+        Register("IpLoop/GradientDamage/" + loop_name, [=](benchmark::State& s) { ThroughIpLoop(s, gradient(), c); });
+        Register("IpLoop/AutoDiffLocalDamage/" + loop_name, [=](benchmark::State& s) {
+            ThroughIpLoop(s, std::make_shared<AutoDiffLocalDamage>(youngs_modulus, nu, c, Omega(), Norm(c)), c);
+        });
+        Register("IpLoop/AutoDiffGradientDamage/" + loop_name, [=](benchmark::State& s) {
+            ThroughIpLoop(s, std::make_shared<AutoDiffGradientDamage>(youngs_modulus, nu, c, Omega(), Norm(c)), c);
+        });
+
+        Register("Direct/LinearElastic/" + name, [=](benchmark::State& s) { DirectMechanicsLaw(s, elastic(), c); });
+        Register("Direct/LocalDamage/" + name, [=](benchmark::State& s) { DirectMechanicsLaw(s, local(), c); });
+        Register("Direct/GradientDamage/" + name, [=](benchmark::State& s) { DirectGradientDamage(s, c); });
+        Register("Direct/ModMisesEeq/" + name, [=](benchmark::State& s) { DirectNorm(s, ModMisesEeq(10., nu, c), c); });
+        Register("Direct/NormVM/" + name, [=](benchmark::State& s) { DirectNorm(s, NormVM(c), c); });
+    }
+    // independent of the constraint
+    Register("Direct/DamageLawExponential", DirectDamageLaw);
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    // removes --threads=N before google benchmark sees the arguments
+    const std::string threads = "--threads=";
+    int kept = 1;
+    for (int i = 1; i < argc; ++i)
+        if (std::string(argv[i]).compare(0, threads.size(), threads) == 0)
+            num_threads = std::stoi(argv[i] + threads.size());
+        else
+            argv[kept++] = argv[i];
+    argc = kept;
+
+    RegisterAll();
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -0,0 +1,315 @@
+//! @brief Thread and problem size scaling of the `IpLoop` for the built-in
+//! laws, compared to the memory bandwidth of a STREAM-like triad measured in
+//! the same binary with the same threads.
+//!
+//!     ./benchmark_scaling --threads 1,2,4,8 --ips 1000,100000,1000000
+//!     ./benchmark_scaling --constraint FULL --csv > $(hostname).csv
+//!     ./benchmark_scaling --json scaling.json
+//!
+//! For each law, number of IPs and number of threads, it reports the time of
+//! an `IpLoop::Evaluate` per IP, the speedup and parallel efficiency w.r.t.
+//! the first thread count and the achieved bandwidth. The bandwidth counts
+//! the bytes of the arena (inputs, outputs and histories) once per pass, so
+//! it is a lower bound of the actual traffic. Once it approaches the triad
+//! bandwidth, more threads do not help.
+//!
+//! The first line names the machine (a comment in the CSV), so tables of
+//! different node types can be compared directly. `--json` additionally
+//! writes one record per row in the format of compare.py, named e.g.
+//! "Scaling/LocalDamage/PLANE_STRAIN/100000/threads:4", so the scaling is
+//! tracked by its regression check as well.
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include "allocations.h"
+#include "linear_elastic.h"
+#include "local_damage.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+const double youngs_modulus = 20000., nu = 0.2, k0 = 1.e-4;
+
+const std::map<std::string, Constraint> constraints = {{"UNIAXIAL_STRAIN", UNIAXIAL_STRAIN},
+                                                       {"UNIAXIAL_STRESS", UNIAXIAL_STRESS},
+                                                       {"PLANE_STRAIN", PLANE_STRAIN},
+                                                       {"PLANE_STRESS", PLANE_STRESS},
+                                                       {"FULL", FULL}};
+
+struct Options
+{
+    std::vector<int> threads;
+    std::vector<int> ips = {1000, 10000, 100000, 1000000};
+    std::string constraint = "PLANE_STRAIN";
+    long stream_size = 1L << 24;
+    double min_time = 0.05;
+    bool csv = false;
+    std::string json;
+};
+
+std::vector<int> ParseList(const std::string& list)
+{
+    std::vector<int> values;
+    std::stringstream stream(list);
+    std::string value;
+    while (std::getline(stream, value, ','))
+        values.push_back(std::stoi(value));
+    return values;
+}
+
+Options Parse(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        auto next = [&]() {
+            if (i + 1 == argc)
+                throw std::runtime_error("Missing value of " + arg + ".");
+            return std::string(argv[++i]);
+        };
+        if (arg == "--threads")
+            options.threads = ParseList(next());
+        else if (arg == "--ips")
+            options.ips = ParseList(next());
+        else if (arg == "--stream-size")
+            options.stream_size = std::stol(next());
+        else if (arg == "--min-time")
+            options.min_time = std::stod(next());
+        else if (arg == "--constraint")
+            options.constraint = next();
+        else if (arg == "--csv")
+            options.csv = true;
+        else if (arg == "--json")
+            options.json = next();
+        else
+            throw std::runtime_error("Unknown argument " + arg + ", see the header of scaling.cpp.");
+    }
+    if (constraints.count(options.constraint) == 0)
+        throw std::runtime_error("Unknown constraint " + options.constraint + ".");
+    if (options.threads.empty())
+    {
+        // powers of two up to the number of processors
+        int max_threads = 1;
+#ifdef _OPENMP
+        max_threads = omp_get_num_procs();
+#endif
+        for (int t = 1; t < max_threads; t *= 2)
+            options.threads.push_back(t);
+        options.threads.push_back(max_threads);
+    }
+    return options;
+}
+
+//! @brief best time of `f` out of 5 rounds, each repeated until it took
+//! `min_time` seconds
+double BestTime(const std::function<void()>& f, double min_time)
+{
+    int repetitions = 1;
+    double best = std::numeric_limits<double>::max();
+    for (int round = 0; round < 5; ++round)
+    {
+        double seconds;
+        while (true)
+        {
+            const auto start = Clock::now();
+            for (int r = 0; r < repetitions; ++r)
+                f();
+            seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            if (seconds >= min_time)
+                break;
+            repetitions *= 2;
+        }
+        best = std::min(best, seconds / repetitions);
+    }
+    return best;
+}
+
+//! @brief GB/s of the triad a = b + s c with `threads` threads, counting
+//! 3 x 8 bytes per element as STREAM does. The arrays are not initialized on
+//! allocation, so the threads touch their pages first, as in the arena.
+double Triad(long size, int threads, double min_time)
+{
+    std::unique_ptr<double[]> a(new double[size]), b(new double[size]), c(new double[size]);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(threads)
+#endif
+    for (long i = 0; i < size; ++i)
+    {
+        a[i] = 0.;
+        b[i] = 1.;
+        c[i] = 2.;
+    }
+    const double seconds = BestTime(
+            [&]() {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(threads)
+#endif
+                for (long i = 0; i < size; ++i)
+                    a[i] = b[i] + 3. * c[i];
+            },
+            min_time);
+    return 3. * sizeof(double) * size / seconds * 1.e-9;
+}
+
+std::string Machine()
+{
+    char hostname[256] = "unknown";
+    gethostname(hostname, sizeof(hostname) - 1);
+    std::string cpu = "unknown";
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    for (std::string line; std::getline(cpuinfo, line);)
+        if (line.rfind("model name", 0) == 0)
+        {
+            cpu = line.substr(line.find(':') + 2);
+            break;
+        }
+    int processors = 1;
+#ifdef _OPENMP
+    processors = omp_get_num_procs();
+#endif
+    return std::string(hostname) + ", " + cpu + ", " + std::to_string(processors) + " processors";
+}
+
+struct Row
+{
+    std::string law;
+    int ips;
+    int threads;
+    double seconds;
+    double bytes;
+    double stream;
+    double allocations;
+};
+
+void Print(const std::vector<Row>& rows, bool csv)
+{
+    if (csv)
+        std::cout << "law,ips,threads,ns_per_ip,speedup,efficiency,GB/s,stream_GB/s,fraction_of_stream\n";
+    else
+        std::cout << std::setw(15) << "law" << std::setw(9) << "IPs" << std::setw(8) << "threads" << std::setw(10)
+                  << "ns/IP" << std::setw(9) << "speedup" << std::setw(11) << "efficiency" << std::setw(8) << "GB/s"
+                  << std::setw(13) << "stream GB/s" << std::setw(11) << "of stream" << "\n";
+
+    double reference = 0.;
+    int reference_threads = 1;
+    for (unsigned r = 0; r < rows.size(); ++r)
+    {
+        const Row& row = rows[r];
+        // the first thread count of each law and size is the reference
+        if (r == 0 or row.law != rows[r - 1].law or row.ips != rows[r - 1].ips)
+        {
+            reference = row.seconds;
+            reference_threads = row.threads;
+        }
+        const double speedup = reference / row.seconds;
+        const double efficiency = speedup * reference_threads / row.threads;
+        const double bandwidth = row.bytes / row.seconds * 1.e-9;
+        const double ns_per_ip = row.seconds / row.ips * 1.e9;
+        if (csv)
+            std::cout << row.law << "," << row.ips << "," << row.threads << "," << ns_per_ip << "," << speedup << ","
+                      << efficiency << "," << bandwidth << "," << row.stream << "," << bandwidth / row.stream
+                      << "\n";
+        else
+            std::cout << std::fixed << std::setprecision(2) << std::setw(15) << row.law << std::setw(9) << row.ips
+                      << std::setw(8) << row.threads << std::setw(10) << ns_per_ip << std::setw(9) << speedup
+                      << std::setw(11) << efficiency << std::setw(8) << bandwidth << std::setw(13) << row.stream
+                      << std::setw(10) << 100. * bandwidth / row.stream << "%\n";
+    }
+}
+
+//! @brief the rows as a JSON list of compare.py records
+void WriteJson(const std::vector<Row>& rows, const std::string& constraint, const std::string& filename)
+{
+    std::ofstream file(filename);
+    if (not file)
+        throw std::runtime_error("Cannot write the records to " + filename + ".");
+    file.precision(15);
+    file << "[";
+    for (unsigned r = 0; r < rows.size(); ++r)
+    {
+        const Row& row = rows[r];
+        file << (r == 0 ? "\n" : ",\n") << " {\"benchmark\": \"Scaling/" << row.law << "/" << constraint << "/"
+             << row.ips << "/threads:" << row.threads << "\", \"law\": \"" << row.law << "\", \"constraint\": \""
+             << constraint << "\", \"ips\": " << row.ips << ", \"threads\": " << row.threads
+             << ", \"ns_per_ip\": " << row.seconds / row.ips * 1.e9 << ", \"bytes_per_ip\": " << row.bytes / row.ips
+             << ", \"allocations\": " << row.allocations << ", \"GB/s\": " << row.bytes / row.seconds * 1.e-9
+             << ", \"stream_GB/s\": " << row.stream << "}";
+    }
+    file << "\n]\n";
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const Options options = Parse(argc, argv);
+    const Constraint constraint = constraints.at(options.constraint);
+
+    std::map<int, double> stream;
+    for (int threads : options.threads)
+        stream[threads] = Triad(options.stream_size, threads, options.min_time);
+
+    const std::vector<std::pair<std::string, std::function<std::shared_ptr<LawInterface>()>>> laws = {
+            {"LinearElastic",
+             [=]() {
+                 return std::make_shared<MechanicsLawAdapter>(
+                         std::make_shared<LinearElastic>(youngs_modulus, nu, constraint));
+             }},
+            {"LocalDamage",
+             [=]() {
+                 return std::make_shared<MechanicsLawAdapter>(std::make_shared<LocalDamage>(
+                         youngs_modulus, nu, constraint, std::make_shared<DamageLawExponential>(k0, 0.99, 100.),
+                         std::make_shared<ModMisesEeq>(10., nu, constraint)));
+             }},
+            {"GradientDamage", [=]() {
+                 return std::make_shared<GradientDamage>(youngs_modulus, nu, constraint,
+                                                         std::make_shared<DamageLawExponential>(k0, 0.99, 100.),
+                                                         std::make_shared<ModMisesEeq>(10., nu, constraint));
+             }}};
+
+    std::vector<Row> rows;
+    for (const auto& law : laws)
+        for (int n : options.ips)
+        {
+            const Eigen::VectorXd strains = 1.e-3 * Eigen::VectorXd::Random(static_cast<Eigen::Index>(n) *
+                                                                            Dim::Q(constraint));
+            const Eigen::VectorXd neeq = 0.5 * strains.head(n).cwiseAbs();
+            for (int threads : options.threads)
+            {
+                // The threads touch the arena first in `Resize`.
+                IpLoop loop;
+                loop.AddLaw(law.second(), {});
+                loop.SetNumThreads(threads);
+                loop.Resize(n);
+                loop.Evaluate(strains, neeq);
+
+                const long before = allocations::Count();
+                loop.Evaluate();
+                const double allocated = static_cast<double>(allocations::Count() - before);
+
+                const double seconds = BestTime([&]() { loop.Evaluate(); }, options.min_time);
+                rows.push_back({law.first, n, threads, seconds, static_cast<double>(loop.Bytes()), stream[threads],
+                                allocated});
+            }
+        }
+
+    std::cout << (options.csv ? "# " : "") << Machine() << (options.csv ? "\n" : "\n\n");
+    Print(rows, options.csv);
+    if (not options.json.empty())
+        WriteJson(rows, options.constraint, options.json);
+    return 0;
+}
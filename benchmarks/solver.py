@@ -0,0 +1,264 @@
+"""
+End-to-end solver benchmark
+===========================
+
+Runs a fixed number of load steps of
+
+    * ``plate_with_hole``: the linear elastic plate of
+      ``examples/plate_with_hole.py``, loaded by the analytic traction
+    * ``gradient_damage``: the three-point bending test of
+      ``examples/gradient_damage.py`` with the ``GradientDamage`` law
+
+on meshes that are uniformly refined ``--refine`` times and reports the wall
+time of each phase of the Newton iterations::
+
+    python3 benchmarks/solver.py plate_with_hole --refine 2 --steps 5
+    python3 benchmarks/solver.py gradient_damage --refine 1 --steps 10 --threads 4
+
+The phases are recorded by the dolfin timers of ``MechanicsProblem``, see
+``constitutive.timer``. The linear solve is what remains of the Newton solver
+after the residual and the Jacobian callbacks.
+"""
+
+import argparse
+import pathlib
+import sys
+import time
+
+import dolfin as df
+import numpy as np
+
+root = pathlib.Path(__file__).resolve().parents[1]
+sys.path.insert(0, str(root))
+sys.path.insert(0, str(root / "test"))
+
+import constitutive as c
+from fenics_helpers import boundary
+
+PHASES = ["strains", "evaluate", "set_q", "residual", "jacobian", "update"]
+
+
+def plate_with_hole(refine, prm):
+    from test_plate_with_hole import PlateWithHoleSolution, StressSolution
+
+    prm.constraint = c.Constraint.PLANE_STRESS
+    mesh = df.Mesh()
+    with df.XDMFFile(str(root / "test" / "plate.xdmf")) as f:
+        f.read(mesh)
+    for _ in range(refine):
+        mesh = df.refine(mesh)
+
+    problem = c.MechanicsProblem(mesh, prm, c.LinearElastic(prm.E, prm.nu, prm.constraint))
+
+    bc0 = df.DirichletBC(problem.Vd.sub(0), 0.0, boundary.plane_at(0, "x"))
+    bc1 = df.DirichletBC(problem.Vd.sub(1), 0.0, boundary.plane_at(0, "y"))
+    problem.set_bcs([bc0, bc1])
+
+    load = df.Constant(0.0)
+    solution = PlateWithHoleSolution(L=4.0, E=prm.E, nu=prm.nu, radius=1.0)
+    traction = load * df.dot(StressSolution(solution, degree=2), df.FacetNormal(mesh))
+    problem.add_force_term(df.dot(df.TestFunction(problem.Vd), traction) * df.ds)
+
+    def set_load(t):
+        load.assign(t)
+
+    return problem, set_load
+
+
+class GradientDamageProblem(c.MechanicsProblem):
+    """
+    Displacements and nonlocal equivalent strains in a mixed space, as the
+    GDMProblem in test/test_gradient_damage.py, with the same phase timers
+    as the MechanicsProblem.
+    """
+
+    def __init__(self, mesh, prm, law):
+        df.NonlinearProblem.__init__(self)
+        self.mesh = mesh
+        self.prm = prm
+
+        metadata = {"quadrature_degree": prm.deg_q, "quadrature_scheme": "default"}
+        self.dxm = df.dx(metadata=metadata)
+
+        Ed = df.VectorElement("CG", mesh.ufl_cell(), degree=prm.deg_d)
+        Ee = df.FiniteElement("CG", mesh.ufl_cell(), degree=prm.deg_d)
+        self.V = df.FunctionSpace(mesh, Ed * Ee)
+        self._u = df.Function(self.V, name="d-e mixed space")
+
+        VQF, VQV, VQT = c.helper.spaces(mesh, prm.deg_q, c.q_dim(prm.constraint))
+        Q = c.Q
+        self.q_eps = df.Function(VQV, name="current strains")
+        self.q_e = df.Function(VQF, name="current nonlocal equivalent strains")
+        self.q = {
+            Q.SIGMA: df.Function(VQV),
+            Q.DSIGMA_DEPS: df.Function(VQT),
+            Q.DSIGMA_DE: df.Function(VQV),
+            Q.EEQ: df.Function(VQF),
+            Q.DEEQ: df.Function(VQV),
+        }
+
+        self.law = law
+        self.iploop = c.IpLoop()
+        self.iploop.add_law(law)
+        self.iploop.resize(len(self.q_e.vector().get_local()))
+
+        dd, de = df.TrialFunctions(self.V)
+        d_, e_ = df.TestFunctions(self.V)
+        d, e = df.split(self._u)
+
+        eps = self.eps
+        self.R = df.inner(eps(d_), self.q[Q.SIGMA]) * self.dxm
+        self.R += e_ * (e - self.q[Q.EEQ]) * self.dxm
+        self.R += df.dot(df.grad(e_), prm.l ** 2 * df.grad(e)) * self.dxm
+
+        self.dR = df.inner(eps(dd), self.q[Q.DSIGMA_DEPS] * eps(d_)) * self.dxm
+        self.dR += de * df.dot(self.q[Q.DSIGMA_DE], eps(d_)) * self.dxm
+        self.dR += df.inner(eps(dd), -self.q[Q.DEEQ] * e_) * self.dxm
+        self.dR += de * e_ * self.dxm + df.dot(df.grad(de), prm.l ** 2 * df.grad(e_)) * self.dxm
+
+        self.calculate_eps = c.helper.LocalProjector(eps(d), VQV, self.dxm)
+        self.calculate_e = c.helper.LocalProjector(e, VQF, self.dxm)
+
+        self.fused = False
+        self.tangent_reuse = None
+        self._tangents = True
+        self._assembler = None
+        self._bcs = None
+        self._force = None
+        self._force_vector = None
+        self._solver = None
+
+    @property
+    def u(self):
+        return self._u
+
+    @property
+    def Vd(self):
+        return self.V.split()[0]
+
+    def _inputs(self):
+        with c.timer("strains"):
+            self.calculate_eps(self.q_eps)
+            self.calculate_e(self.q_e)
+        return c.helper.get_q(self.q_eps), c.helper.get_q(self.q_e)
+
+    def evaluate_material(self):
+        inputs = self._inputs()
+        with c.timer("evaluate"):
+            self.iploop.evaluate(*inputs)
+        with c.timer("set_q"):
+            for what, q in self.q.items():
+                c.helper.write_q(q, self.iploop, what)
+
+    def update(self):
+        inputs = self._inputs()
+        with c.timer("update"):
+            self.iploop.update(*inputs)
+        self._new_step()
+
+
+def gradient_damage(refine, prm):
+    prm.constraint = c.Constraint.PLANE_STRAIN
+    prm.l = 200 ** 0.5
+    LX, LY, LX_load = 2000.0, 300.0, 100.0
+    n = 2 ** refine
+    mesh = df.RectangleMesh(df.Point(0, 0), df.Point(LX, LY), 100 * n, 15 * n)
+
+    law = c.GradientDamage(
+        prm.E,
+        prm.nu,
+        prm.constraint,
+        c.DamageLawExponential(k0=2.0 / prm.E, alpha=0.99, beta=100.0),
+        c.ModMisesEeq(k=10.0, nu=prm.nu, constraint=prm.constraint),
+    )
+    problem = GradientDamageProblem(mesh, prm, law)
+
+    left = boundary.point_at((0.0, 0.0), eps=0.1)
+    right = boundary.point_at((LX, 0.0), eps=0.1)
+    top = boundary.within_range([(LX - LX_load) / 2.0, LY], [(LX + LX_load) / 2, LY], eps=0.1)
+
+    bc_expr = df.Expression("d*t", degree=0, t=0, d=-3)
+    problem.set_bcs(
+        [
+            df.DirichletBC(problem.Vd.sub(1), bc_expr, top),
+            df.DirichletBC(problem.Vd.sub(0), 0.0, left, method="pointwise"),
+            df.DirichletBC(problem.Vd.sub(1), 0.0, left, method="pointwise"),
+            df.DirichletBC(problem.Vd.sub(1), 0.0, right, method="pointwise"),
+        ]
+    )
+
+    def set_load(t):
+        bc_expr.t = t
+
+    return problem, set_load
+
+
+WORKLOADS = {"plate_with_hole": plate_with_hole, "gradient_damage": gradient_damage}
+
+
+def phase_wall(clear=df.TimingClear.keep):
+    wall = {}
+    for phase in PHASES:
+        try:
+            wall[phase] = df.timing("constitutive: " + phase, clear)[1]
+        except RuntimeError:  # not timed (yet)
+            wall[phase] = 0.0
+    return wall
+
+
+def run(workload, refine=0, steps=5, threads=1, fused_assembly=False):
+    """
+    Returns the wall time in seconds per phase and some sizes of the problem.
+    """
+    prm = c.Parameters(c.Constraint.PLANE_STRAIN)
+    prm.fused_assembly = fused_assembly
+    problem, set_load = WORKLOADS[workload](refine, prm)
+    problem.iploop.set_num_threads(threads)
+
+    solver = df.NewtonSolver()
+    solver.parameters["linear_solver"] = "mumps"
+    solver.parameters["maximum_iterations"] = 10
+    solver.parameters["error_on_nonconvergence"] = False
+
+    df.timings(df.TimingClear.clear, [df.TimingType.wall])
+    newton, callbacks, iterations = 0.0, 0.0, 0
+    for t in np.linspace(0.0, 1.0, steps + 1)[1:]:
+        set_load(t)
+        before = sum(phase_wall().values())
+        start = time.perf_counter()
+        iterations += solver.solve(problem, problem.u.vector())[0]
+        newton += time.perf_counter() - start
+        callbacks += sum(phase_wall().values()) - before
+        problem.update()
+
+    wall = phase_wall(df.TimingClear.clear)
+    wall["linear solve"] = newton - callbacks
+    sizes = {
+        "cells": problem.mesh.num_cells(),
+        "dofs": problem.u.function_space().dim(),
+        "ips": len(problem.q_eps.vector().get_local()) // c.q_dim(prm.constraint),
+        "newton iterations": iterations,
+    }
+    return wall, sizes
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("workload", choices=sorted(WORKLOADS))
+    parser.add_argument("--refine", type=int, default=0, help="uniform mesh refinements")
+    parser.add_argument("--steps", type=int, default=5, help="load steps")
+    parser.add_argument("--threads", type=int, default=1, help="threads of the IpLoop")
+    parser.add_argument("--fused-assembly", action="store_true")
+    args = parser.parse_args()
+
+    wall, sizes = run(args.workload, args.refine, args.steps, args.threads, args.fused_assembly)
+
+    print(", ".join(f"{key}: {value}" for key, value in sizes.items()))
+    total = sum(wall.values())
+    for phase, seconds in wall.items():
+        print(f"{phase:>14s} {seconds:10.4f} s {100 * seconds / total:6.1f} %")
+    print(f"{'total':>14s} {total:10.4f} s")
+
+
+if __name__ == "__main__":
+    main()
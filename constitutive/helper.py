@@ -42,15 +42,30 @@ displacements of certain DOFs with their reaction forces (*load*). Especially
 for strain-softening materials, this curve can indicate numerical issues
 like snap-backs.
 
-From ``dolfin.DirichletBC.get_boundary_values()`` , we directly extract the 
-``.values()`` as the current displacements and the ``.keys()`` as the DOF 
-numbers. The latter ones are used to extract the reaction (out-of-balance) 
-forces from a given force vector ``R``.
+The DOF numbers of the boundary condition are extracted once from
+``dolfin.DirichletBC.get_boundary_values()``. Only the DOFs owned by this 
+process are kept (a local DOF >= ``R.local_size()`` is a ghost and belongs
+to another process). In each step, the reaction (out-of-balance) forces are 
+gathered from a given force vector ``R`` and the current displacements from
+a vector that the boundary condition is applied to. Both local sums are 
+reduced in a single MPI call.
 
 Special care is taken to make this class work in parallel.
 """
 
 
+def _vector_values(v):
+    """
+    v:
+        dolfin.GenericVector
+    returns:
+        (read-only) local values of `v`, without a copy if possible
+    """
+    if df.has_petsc4py():
+        return df.as_backend_type(v).vec().array_r
+    return v.get_local()
+
+
 class LoadDisplacementCurve:
     def __init__(self, bc):
         """
@@ -60,8 +75,9 @@ class LoadDisplacementCurve:
         self.comm = df.MPI.comm_world
         self.bc = bc
 
-        self.dofs = list(self.bc.get_boundary_values().keys())
-        self.n_dofs = df.MPI.sum(self.comm, len(self.dofs))
+        self.dofs = np.fromiter(self.bc.get_boundary_values().keys(), dtype=np.int64)
+        self.n_dofs = None
+        self._bc_values = None
 
         self.load = []
         self.disp = []
@@ -77,16 +93,21 @@ class LoadDisplacementCurve:
         R:
             residual, out of balance forces
         """
-        # A dof > R.local_size() is (I GUESS?!?!) a ghost node and its
-        # contribution to R is accounted for on the owning process. So it
-        # is (I GUESS?!) safe to ignore it.
-        self.dofs = [d for d in self.dofs if d < R.local_size()]
-
-        load_local = np.sum(R[self.dofs])
-        load = df.MPI.sum(self.comm, load_local)
-
-        disp_local = np.sum(list(self.bc.get_boundary_values().values()))
-        disp = df.MPI.sum(self.comm, disp_local) / self.n_dofs
+        if self._bc_values is None:
+            self.dofs = np.sort(self.dofs[self.dofs < R.local_size()])
+            self.n_dofs = df.MPI.sum(self.comm, len(self.dofs))
+            self._bc_values = R.copy()
+
+        self.bc.apply(self._bc_values)
+
+        local = np.array(
+            [
+                np.sum(_vector_values(R)[self.dofs]),
+                np.sum(_vector_values(self._bc_values)[self.dofs]),
+            ]
+        )
+        load, disp = self.comm.allreduce(local)
+        disp /= self.n_dofs
 
         self.load.append(load)
         self.disp.append(disp)
@@ -151,6 +172,152 @@ class LocalProjector:
         self.solver.solve_local_rhs(u)
 
 
+"""
+Strains at the integration points
+---------------------------------
+
+The strains are a linear function of the displacement DOFs of a cell
+
+.. math::
+    \bm\varepsilon(\bm x_{ip}) = \bm B(\bm x_{ip}) \ \bm u_\text{cell}
+
+and the projection above, an assembly and a local solve per cell, is not
+required to get them. ``QuadratureStrains`` tabulates the derivatives of the
+shape functions at the quadrature points of the reference cell once (via 
+FIAT). The C++ ``BOperator`` maps them to each (affine) cell and evaluates
+the strains of all IPs as a gather of the cell DOFs and a small matrix
+product.
+
+The points are created by FFC, exactly like for the quadrature space, and
+each IP gets its number from the dofmap of the quadrature space.
+
+Fused assembly
+**************
+
+With the quadrature weights, the same operator integrates the element
+residuals and tangents
+
+.. math::
+    \bm r_\text{cell} = \sum_{ip} w_{ip} \bm B^T \bm\sigma, \quad
+    \bm K_\text{cell} = \sum_{ip} w_{ip} \bm B^T 
+    \frac{\partial \bm\sigma}{\partial \bm\varepsilon} \bm B
+
+directly from the outputs of the ``IpLoop``, without writing them into 
+quadrature functions first. ``add_residuals`` and ``add_tangents`` insert 
+all of them into the PETSc objects with a single ``petsc4py`` call each.
+"""
+
+
+class QuadratureStrains:
+    def __init__(self, u, Vd, VQ, deg_q, constraint):
+        """
+        u:
+            (full) solution function
+        Vd:
+            vector valued Lagrange space of the displacements, may be a 
+            subspace of the space of `u`
+        VQ:
+            vector valued quadrature space of the strains
+        deg_q:
+            quadrature degree
+        constraint:
+            constitutive.Constraint
+        """
+        from ffc.fiatinterface import create_element, create_quadrature
+        from .cpp import BOperator
+
+        if not QuadratureStrains.supports(Vd):
+            raise NotImplementedError("Only Lagrange elements on simplices are supported.")
+
+        mesh = Vd.mesh()
+        gdim = mesh.geometric_dimension()
+
+        scalar_element = Vd.ufl_element().sub_elements()[0]
+        points, weights = create_quadrature(mesh.ufl_cell().cellname(), deg_q, "default")
+        tabulated = create_element(scalar_element).tabulate(1, points)
+        derivatives = [tuple(int(i == j) for i in range(gdim)) for j in range(gdim)]
+        reference_gradients = np.stack([tabulated[d].T for d in derivatives], axis=-1)
+
+        cells = range(mesh.num_cells())
+        n_points = len(points)
+        q = VQ.ufl_element().value_size()
+        dofs = np.array([Vd.dofmap().cell_dofs(c) for c in cells], dtype=np.intc)
+        ips = np.array([VQ.dofmap().cell_dofs(c)[:n_points] // q for c in cells], dtype=np.intc)
+        coordinates = mesh.coordinates()[mesh.cells()].reshape(len(cells), (gdim + 1) * gdim)
+
+        self.b = BOperator(constraint, reference_gradients.reshape(-1, gdim), weights, coordinates, dofs, ips)
+        self.u = u
+        self.dofs = dofs
+        self.rows = np.arange(dofs.max() + 1 if len(dofs) else 0, dtype=np.intc)
+
+        self.residuals = np.zeros(dofs.shape)
+        self.tangents = np.zeros((len(dofs), dofs.shape[1] ** 2))
+
+    @staticmethod
+    def supports(Vd):
+        mesh = Vd.mesh()
+        element = Vd.ufl_element()
+        return (
+            mesh.ufl_cell().is_simplex()
+            and mesh.ufl_coordinate_element().degree() == 1
+            and element.family() == "Lagrange"
+            and element.value_size() == mesh.geometric_dimension()
+        )
+
+    def __call__(self, target):
+        """
+        target:
+            quadrature function that is filled with the strains or an
+            IpLoop whose strain input is set directly
+        """
+        v = df.as_backend_type(self.u.vector())
+        v.update_ghost_values()
+        u = v.get_local(self.rows)  # includes the ghost values
+
+        if not isinstance(target, df.Function):
+            self.b.strains(u, target)
+            return
+
+        values = _local_array(target, writable=True)
+        if values is None:
+            values = np.empty(target.vector().local_size())
+            self.b.strains(u, values)
+            set_q(target, values)
+            return
+        self.b.strains(u, values)
+        del values  # restores the PETSc array
+        target.vector().apply("insert")
+
+    def assemble(self, iploop, tangents=True):
+        """
+        Integrates the element residuals (and tangents) from the outputs of
+        the evaluated C++ `iploop`.
+        """
+        self.b.assemble(iploop, self.residuals, self.tangents if tangents else np.zeros((0, 0)))
+
+    def add_residuals(self, b):
+        """
+        b:
+            dolfin vector with the sparsity of the residual form
+        """
+        from petsc4py import PETSc
+
+        vec = df.as_backend_type(b).vec()
+        vec.setValuesLocal(self.dofs.ravel(), self.residuals.ravel(), addv=PETSc.InsertMode.ADD)
+        b.apply("add")
+
+    def add_tangents(self, A):
+        """
+        A:
+            dolfin matrix with the sparsity of the tangent form
+        """
+        from petsc4py import PETSc
+
+        mat = df.as_backend_type(A).mat()
+        mat.setValuesLocalRCV(self.dofs, self.dofs, self.tangents, addv=PETSc.InsertMode.ADD)
+        A.apply("add")
+
+
 """
 Setting values for the quadrature space
 ---------------------------------------
@@ -176,6 +343,58 @@ def set_q(q, values):
     v.apply("insert")
 
 
+"""
+Direct access to the quadrature space values
+--------------------------------------------
+
+Even ``set_q`` needs a flattened copy of the values and a PETSc add pass. 
+With ``petsc4py``, the local array of the PETSc vector (``VecGetArray``) is 
+available as a numpy view. The ``IpLoop`` reads its inputs from and writes 
+its outputs directly into these views without any intermediate copies.
+
+Both functions fall back to the copies, e.g. for a python implementation of
+the ``IpLoop``.
+"""
+
+
+def _local_array(q, writable):
+    if not df.has_petsc4py():
+        return None
+    vec = df.as_backend_type(q.vector()).vec()
+    return vec.array_w if writable else vec.array_r
+
+
+def get_q(q):
+    """
+    q:
+        quadrature function space
+    returns:
+        (read-only) local values of `q`
+    """
+    values = _local_array(q, writable=False)
+    if values is None:
+        return q.vector().get_local()
+    return values
+
+
+def write_q(q, iploop, what):
+    """
+    q:
+        quadrature function space
+    iploop:
+        (evaluated) constitutive.IpLoop
+    what:
+        constitutive.Q of the output to write into `q`
+    """
+    values = _local_array(q, writable=True) if hasattr(iploop, "write_to") else None
+    if values is None:
+        set_q(q, iploop.get(what))
+        return
+    iploop.write_to(what, values)
+    del values  # restores the PETSc array
+    q.vector().apply("insert")
+
+
 def spaces(mesh, deg_q, qdim):
     cell = mesh.ufl_cell()
     q = "Quadrature"
@@ -183,3 +402,27 @@ def spaces(mesh, deg_q, qdim):
     QV = df.VectorElement(q, cell, deg_q, quad_scheme="default", dim=qdim)
     QT = df.TensorElement(q, cell, deg_q, quad_scheme="default", shape=(qdim, qdim))
     return [df.FunctionSpace(mesh, Q) for Q in [QF, QV, QT]]
+
+
+"""
+Timeline
+--------
+
+With ``Tracer.enable()``, the ``IpLoop`` records its phases, the batch of
+each law and the chunk of each thread, and the ``MechanicsProblem`` its
+solver phases. ``write_trace`` collects the events of all MPI ranks, each as
+its own process, into one Chrome trace file that is viewed offline in
+chrome://tracing or the Perfetto UI.
+"""
+
+
+def write_trace(filename, comm=None):
+    from .cpp import Tracer
+
+    comm = comm or df.MPI.comm_world
+    events = comm.gather(Tracer.json(pid=comm.rank), root=0)
+    if comm.rank == 0:
+        with open(filename, "w") as f:
+            f.write('{"traceEvents": [\n')
+            f.write(",\n".join(e for e in events if e))
+            f.write("\n]}\n")
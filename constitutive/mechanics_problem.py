@@ -1,7 +1,22 @@
 import dolfin as df
+from contextlib import contextmanager
 from . import helper as h
 from .cpp import *
 
+@contextmanager
+def timer(phase):
+    """
+    dolfin timer of one phase of the solution, e.g. "strains", "evaluate",
+    "set_q", "residual", "jacobian" or "update". They are collected by
+    benchmarks/solver.py via `df.timing("constitutive: " + phase)`. The
+    phase is also recorded by the `Tracer`, if enabled.
+    """
+    start = Tracer.now()
+    with df.Timer("constitutive: " + phase):
+        yield
+    Tracer.complete(phase, start)
+
+
 class Parameters:
     def __init__(self, constraint):
         self.constraint = constraint
@@ -12,6 +27,9 @@ class Parameters:
         # quadrature degree
         self.deg_q = 2
 
+        # integrate residual and tangent in C++ directly from the IpLoop
+        self.fused_assembly = False
+
         self.E = 20000.
         self.nu = 0.2
         self.ft = 4.
@@ -20,7 +38,69 @@ class Parameters:
         self.k = 10.
 
 
+class TangentReuse:
+    def __init__(self, every=1, ratio=None):
+        """
+        Jacobian reuse policy of a modified Newton method. The tangent is
+        reassembled every `every` iterations, counted across load steps, and,
+        if `ratio` is given, whenever the last iteration reduced the residual
+        norm by less than that, i.e. |r_k| > ratio |r_k-1|. Only residuals of
+        the same load step are compared, see `new_step`. `every=1` is the
+        full Newton-Raphson method.
+
+        A matrix that is not reassembled keeps the factorization (or the
+        preconditioner) of the linear solver, as PETSc only sets it up again
+        for a modified operator.
+        """
+        self.every = every
+        self.ratio = ratio
+        self.num_assembled = 0
+        self.num_reused = 0
+        self._age = None
+        self._norms = []
+
+    def residual(self, norm):
+        self._norms = self._norms[-1:] + [norm]
+
+    def new_step(self):
+        """
+        Forgets the residuals of the last load step. The first residual of
+        the next one grows with the load increment, not with a poor tangent.
+        The age of the tangent is kept.
+        """
+        self._norms = []
+
+    def expects_assembly(self):
+        """
+        True, if the next Jacobian is reassembled regardless of the residual.
+        """
+        return self._age is None or self._age + 1 >= self.every
+
+    def assemble(self, required=False):
+        """
+        Decides whether the current Jacobian is reassembled. It is
+        `required`, if there is no matrix to reuse yet.
+        """
+        degraded = self.ratio is not None and len(self._norms) == 2 and self._norms[1] > self.ratio * self._norms[0]
+        if required or self.expects_assembly() or degraded:
+            self._age = 0
+            self.num_assembled += 1
+            return True
+        self._age += 1
+        self.num_reused += 1
+        return False
+
+
 class MechanicsProblem(df.NonlinearProblem):
+    # also for derived problems that do not call __init__, e.g. the mixed
+    # GDMProblem in test/test_gradient_damage.py
+    fused = False
+    tangent_reuse = None
+    _tangents = True
+    _force = None
+    _force_vector = None
+    _solver = None
+
     def __init__(self, mesh, prm, law, iploop=None):
         df.NonlinearProblem.__init__(self)
 
@@ -60,13 +140,31 @@ class MechanicsProblem(df.NonlinearProblem):
         self.R = df.inner(eps(d_), self.q_sigma) * self.dxm
         self.dR = df.inner(eps(dd), self.q_dsigma_deps * eps(d_)) * self.dxm
 
-        self.calculate_eps = h.LocalProjector(eps(self.d), VQV, self.dxm)
+        if h.QuadratureStrains.supports(self.Vd):
+            self.calculate_eps = h.QuadratureStrains(self.u, self.Vd, VQV, prm.deg_q, prm.constraint)
+        else:
+            self.calculate_eps = h.LocalProjector(eps(self.d), VQV, self.dxm)
+
+        self.fused = prm.fused_assembly
+        if self.fused and not (self._direct() and df.has_petsc4py()):
+            raise RuntimeError(
+                "The fused assembly requires the C++ IpLoop, petsc4py and a Lagrange displacement space on simplices."
+            )
+
+        # full Newton-Raphson method, see TangentReuse for a modified one
+        self.tangent_reuse = None
+        self._tangents = True
 
         self._assembler = None
         self._bcs = None
+        self._force = None
+        self._force_vector = None
+        self._solver = None
 
     def add_force_term(self, term):
         self.R -= term
+        self._force = term if self._force is None else self._force + term
+        self._force_vector = None
         if self._bcs is not None:
             # update it to the new self.R!
             self.set_bcs(self._bcs)
@@ -101,18 +199,44 @@ class MechanicsProblem(df.NonlinearProblem):
             )
 
     def evaluate_material(self):
-        # project the strain and the nonlocal equivalent strains onto
-        # their quadrature spaces and ...
-        self.calculate_eps(self.q_eps)
-        self.iploop.evaluate(self.q_eps.vector().get_local())
+        # calculate the strains at the quadrature points and ...
+        self._pass_strains(self.iploop.evaluate)
 
         # ... and write the calculated values into their quadrature spaces.
-        h.set_q(self.q_sigma, self.iploop.get(Q.SIGMA))
-        h.set_q(self.q_dsigma_deps, self.iploop.get(Q.DSIGMA_DEPS))
+        with timer("set_q"):
+            h.write_q(self.q_sigma, self.iploop, Q.SIGMA)
+            if self._tangents:
+                h.write_q(self.q_dsigma_deps, self.iploop, Q.DSIGMA_DEPS)
 
     def update(self):
-        self.calculate_eps(self.q_eps)
-        self.iploop.update(self.q_eps.vector().get_local())
+        self._pass_strains(self.iploop.update, "update")
+        self._new_step()
+
+    def _new_step(self):
+        # the loads may change between the steps
+        self._force_vector = None
+        if self.tangent_reuse is not None:
+            self.tangent_reuse.new_step()
+
+    def _pass_strains(self, evaluate, phase="evaluate"):
+        """
+        Calls `evaluate` (iploop.evaluate or iploop.update) with the current
+        strains. The C++ IpLoop gets them directly from the `BOperator` and
+        `self.q_eps` is not updated in that case.
+        """
+        if self._direct():
+            with timer("strains"):
+                self.calculate_eps(self.iploop)
+            with timer(phase):
+                evaluate()
+        else:
+            with timer("strains"):
+                self.calculate_eps(self.q_eps)
+            with timer(phase):
+                evaluate(h.get_q(self.q_eps))
+
+    def _direct(self):
+        return isinstance(self.iploop, IpLoop) and isinstance(self.calculate_eps, h.QuadratureStrains)
 
 
     def set_bcs(self, bcs):
@@ -123,14 +247,89 @@ class MechanicsProblem(df.NonlinearProblem):
     def F(self, b, x):
         if not self._assembler:
             raise RuntimeError("You need to `.set_bcs(bcs)` before the solve!")
-        self.evaluate_material()
-        self._assembler.assemble(b, x)
+
+        # Tangents that the next J would discard are not computed at all.
+        reuse = self.tangent_reuse
+        self._set_compute_tangents(reuse is None or reuse.expects_assembly())
+
+        if self.fused:
+            self._fused_F(b, x)
+        else:
+            self.evaluate_material()
+            with timer("residual"):
+                self._assembler.assemble(b, x)
+
+        if reuse is not None:
+            reuse.residual(b.norm("l2"))
 
     def J(self, A, x):
-        self._assembler.assemble(A)
+        reuse = self.tangent_reuse
+        if reuse is not None and not reuse.assemble(required=A.empty()):
+            return  # keeps A and the factorization
+
+        if not self._tangents:
+            # The residual degraded unexpectedly, the tangents are missing.
+            self._set_compute_tangents(True)
+            if self.fused:
+                self._pass_strains(self.iploop.evaluate)
+                with timer("residual"):
+                    self.calculate_eps.assemble(self.iploop)
+            else:
+                self.evaluate_material()
+
+        with timer("jacobian"):
+            if self.fused:
+                self._fused_J(A)
+            else:
+                self._assembler.assemble(A)
+
+    def _set_compute_tangents(self, compute):
+        # A python IpLoop always computes them.
+        if hasattr(self.iploop, "set_compute_tangents"):
+            self.iploop.set_compute_tangents(compute)
+            self._tangents = compute
+
+    def _fused_F(self, b, x):
+        """
+        Evaluates the material and integrates both the residual and the
+        tangent in one pass. The tangents are kept for the following `J`.
+        The quadrature functions `q_sigma` and `q_dsigma_deps` are not
+        filled. The force terms are assembled once per load step, i.e.
+        again after `solve` or `update`.
+        """
+        if b.empty():
+            self._assembler.assemble(b, x)  # only for the layout
+
+        self._pass_strains(self.iploop.evaluate)
+
+        # includes the integration of the tangents
+        with timer("residual"):
+            self.calculate_eps.assemble(self.iploop, tangents=self._tangents)
+
+            b.zero()
+            self.calculate_eps.add_residuals(b)
+            if self._force is not None:
+                if self._force_vector is None:
+                    self._force_vector = df.assemble(self._force)
+                b.axpy(-1.0, self._force_vector)
+            for bc in self._bcs:
+                bc.apply(b, x)
+
+    def _fused_J(self, A):
+        if A.empty():
+            self._assembler.assemble(A)  # only for the sparsity pattern
+
+        A.zero()
+        self.calculate_eps.add_tangents(A)
+        for bc in self._bcs:
+            bc.apply(A)
 
     def solve(self, solver=None):
         if solver is None:
-            solver = df.NewtonSolver()
+            # kept, such that its linear solver can reuse a factorization
+            # in the next load step
+            self._solver = self._solver or df.NewtonSolver()
+            solver = self._solver
+        self._new_step()
         solver.solve(self, self.u.vector())
         return self.u
@@ -0,0 +1,290 @@
+#pragma once
+#include "dual.h"
+#include "local_damage.h"
+
+//! @brief Derives the tangents of an isotropic damage law
+//!
+//!     stress = (1 - omega) C strain
+//!
+//! by forward mode automatic differentiation, see `Dual`. The prototype
+//! `TLaw` provides
+//!
+//!     // E is an input and DSIGMA_DE an output
+//!     static constexpr bool nonlocal;
+//!     // EEQ and its derivative DEEQ are outputs
+//!     static constexpr bool equivalent_strain;
+//!     // the integrity does not depend on the strains, so the tangent
+//!     // (1 - omega) C is symmetric and stored packed
+//!     static constexpr bool symmetric_tangent;
+//!     int Q() const;
+//!     const MatrixQ& Elasticity() const;
+//!     // the integrity 1 - omega (and eeq) of IP i for any scalar type T
+//!     template <typename T>
+//!     T Integrity(const VectorQT<T>& strain, const T& e, int i, T& eeq) const;
+//!     void Update(const VectorQ& strain, double e, int i);
+//!     void Resize(int n);
+//!     std::vector<QValues*> History();
+//!
+//! The strains (and E) are the independent variables, so only the (Q + 1)
+//! derivatives that are actually needed are propagated. Only the scalar path
+//! strain -> eeq -> kappa -> omega carries them. The tangent
+//!
+//!     (1 - omega) C + (C strain) x d(1 - omega)/dstrain
+//!
+//! is formed in double, as C strain in duals would cost O(Q^2 N) operations.
+template <typename TLaw>
+class AutoDiffLaw : public LawInterface
+{
+public:
+    template <typename... TArgs>
+    AutoDiffLaw(TArgs&&... args)
+        : _law(std::forward<TArgs>(args)...)
+    {
+    }
+
+    void DefineOutputs(std::vector<QValues>& out) const override
+    {
+        const int q = _law.Q();
+        out[SIGMA] = QValues(q);
+        out[DSIGMA_DEPS] = QValues(q, q, TLaw::symmetric_tangent ? SYMMETRIC : DENSE);
+        if (TLaw::nonlocal)
+            out[DSIGMA_DE] = QValues(q);
+        if (TLaw::equivalent_strain)
+        {
+            out[EEQ] = QValues(1);
+            out[DEEQ] = QValues(q);
+        }
+    }
+
+    void DefineInputs(std::vector<QValues>& input) const override
+    {
+        input[EPS] = QValues(_law.Q());
+        if (TLaw::nonlocal)
+            input[E] = QValues(1);
+    }
+
+    void Evaluate(const std::vector<QValues>& input, std::vector<QValues>& out, int i) override
+    {
+        constexpr int e = TLaw::nonlocal ? 1 : 0;
+        switch (_law.Q())
+        {
+        case 1:
+            return Evaluate<1 + e>(input, out, i);
+        case 3:
+            return Evaluate<3 + e>(input, out, i);
+        case 6:
+            return Evaluate<6 + e>(input, out, i);
+        default:
+            throw std::runtime_error("AutoDiffLaw: unsupported number of strains.");
+        }
+    }
+
+    void EvaluateWithoutTangents(const std::vector<QValues>& input, std::vector<QValues>& out, int i) override
+    {
+        const int q = _law.Q();
+        VectorQ strain(q), stress(q);
+        input[EPS].GetTo(i, strain);
+        const double e = TLaw::nonlocal ? input[E].GetScalar(i) : 0.;
+        double eeq = 0.;
+        const double integrity = _law.Integrity(strain, e, i, eeq);
+        stress.noalias() = integrity * _law.Elasticity() * strain;
+        out[SIGMA].Set(stress, i);
+        if (TLaw::equivalent_strain)
+            out[EEQ].Set(eeq, i);
+    }
+
+    void Update(const std::vector<QValues>& input, int i) override
+    {
+        VectorQ strain(_law.Q());
+        input[EPS].GetTo(i, strain);
+        _law.Update(strain, TLaw::nonlocal ? input[E].GetScalar(i) : 0., i);
+    }
+
+    void Resize(int n) override
+    {
+        _law.Resize(n);
+    }
+
+    std::vector<QValues*> History() override
+    {
+        return _law.History();
+    }
+
+    TLaw& Law()
+    {
+        return _law;
+    }
+
+private:
+    template <int N>
+    void Evaluate(const std::vector<QValues>& input, std::vector<QValues>& out, int i)
+    {
+        using D = Dual<N>;
+        const int q = _law.Q();
+        VectorQ values(q);
+        input[EPS].GetTo(i, values);
+
+        VectorQT<D> strain(q);
+        for (int j = 0; j < q; ++j)
+            strain[j] = D::Variable(values[j], j);
+        const D e = TLaw::nonlocal ? D::Variable(input[E].GetScalar(i), q) : D(0.);
+        D eeq;
+        const D integrity = _law.Integrity(strain, e, i, eeq);
+
+        const MatrixQ& C = _law.Elasticity();
+        const VectorQ elastic_stress = C * values;
+        MatrixQ tangent(q, q);
+        tangent.noalias() = integrity.value * C;
+        if (not TLaw::symmetric_tangent)
+        {
+            VectorQ dintegrity(q);
+            for (int col = 0; col < q; ++col)
+                dintegrity[col] = integrity.gradient[col];
+            tangent.noalias() += elastic_stress * dintegrity.transpose();
+        }
+        values = integrity.value * elastic_stress;
+        out[SIGMA].Set(values, i);
+        out[DSIGMA_DEPS].Set(tangent, i);
+
+        if (TLaw::nonlocal)
+        {
+            values = integrity.gradient[q] * elastic_stress;
+            out[DSIGMA_DE].Set(values, i);
+        }
+        if (TLaw::equivalent_strain)
+        {
+            out[EEQ].Set(eeq.value, i);
+            for (int col = 0; col < q; ++col)
+                values[col] = eeq.gradient[col];
+            out[DEEQ].Set(values, i);
+        }
+    }
+
+    TLaw _law;
+};
+
+//! @brief the stresses of `LocalDamage` as prototype of an `AutoDiffLaw`
+class LocalDamageStress
+{
+public:
+    static constexpr bool nonlocal = false;
+    static constexpr bool equivalent_strain = false;
+    static constexpr bool symmetric_tangent = false;
+
+    LocalDamageStress(double E, double nu, Constraint c, std::shared_ptr<DamageLawExponential> omega,
+                      std::shared_ptr<ModMisesEeq> strain_norm)
+        : _C(C(E, nu, c))
+        , _omega(omega)
+        , _strain_norm(strain_norm)
+        , _kappa(1)
+    {
+    }
+
+    int Q() const
+    {
+        return _C.rows();
+    }
+
+    const MatrixQ& Elasticity() const
+    {
+        return _C;
+    }
+
+    template <typename T>
+    T Integrity(const VectorQT<T>& strain, const T& e, int i, T& eeq) const
+    {
+        const T kappa = std::max(_strain_norm->Norm(strain), T(_kappa.GetScalar(i)));
+        return 1. - _omega->Omega(kappa);
+    }
+
+    void Update(const VectorQ& strain, double e, int i)
+    {
+        _kappa.Set(std::max(_strain_norm->Norm<double>(strain), _kappa.GetScalar(i)), i);
+    }
+
+    void Resize(int n)
+    {
+        _kappa.Resize(n);
+    }
+
+    std::vector<QValues*> History()
+    {
+        return {&_kappa};
+    }
+
+    Eigen::VectorXd Kappa() const
+    {
+        return _kappa.Values();
+    }
+
+private:
+    MatrixQ _C;
+    std::shared_ptr<DamageLawExponential> _omega;
+    std::shared_ptr<ModMisesEeq> _strain_norm;
+    QValues _kappa;
+};
+
+//! @brief the stresses of `GradientDamage` as prototype of an `AutoDiffLaw`
+class GradientDamageStress
+{
+public:
+    static constexpr bool nonlocal = true;
+    static constexpr bool equivalent_strain = true;
+    static constexpr bool symmetric_tangent = true;
+
+    GradientDamageStress(double E, double nu, Constraint c, std::shared_ptr<DamageLawExponential> omega,
+                         std::shared_ptr<ModMisesEeq> strain_norm)
+        : _C(C(E, nu, c))
+        , _omega(omega)
+        , _strain_norm(strain_norm)
+        , _kappa(1)
+    {
+    }
+
+    int Q() const
+    {
+        return _C.rows();
+    }
+
+    const MatrixQ& Elasticity() const
+    {
+        return _C;
+    }
+
+    template <typename T>
+    T Integrity(const VectorQT<T>& strain, const T& e, int i, T& eeq) const
+    {
+        const T kappa = std::max(e, T(_kappa.GetScalar(i)));
+        eeq = _strain_norm->Norm(strain);
+        return 1. - _omega->Omega(kappa);
+    }
+
+    void Update(const VectorQ& strain, double e, int i)
+    {
+        _kappa.Set(std::max(e, _kappa.GetScalar(i)), i);
+    }
+
+    void Resize(int n)
+    {
+        _kappa.Resize(n);
+    }
+
+    std::vector<QValues*> History()
+    {
+        return {&_kappa};
+    }
+
+    Eigen::VectorXd Kappa() const
+    {
+        return _kappa.Values();
+    }
+
+private:
+    MatrixQ _C;
+    std::shared_ptr<DamageLawExponential> _omega;
+    std::shared_ptr<ModMisesEeq> _strain_norm;
+    QValues _kappa;
+};
+
+using AutoDiffLocalDamage = AutoDiffLaw<LocalDamageStress>;
+using AutoDiffGradientDamage = AutoDiffLaw<GradientDamageStress>;
@@ -0,0 +1,222 @@
+#pragma once
+#include "interfaces.h"
+#include <eigen3/Eigen/LU>
+#include <algorithm>
+#include <cmath>
+
+using RowMatrixXd = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+using RowMatrixXi = Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+//! @brief Maps the displacement DOFs of a vector valued Lagrange space on
+//! affine simplices to the strains at the integration points.
+//!
+//! The gradients of the scalar shape functions are tabulated once on the
+//! reference cell and mapped to each cell here. This replaces the
+//! projection of the strains into the quadrature space by a gather of the
+//! cell DOFs and a small matrix product per IP. With the quadrature weights,
+//! it also assembles the element residuals and tangents from the outputs of
+//! an `IpLoop`.
+class BOperator
+{
+public:
+    //! @param reference_gradients (num_points * num_shape_functions) x gdim,
+    //!        point major, shape function derivatives on the reference cell
+    //! @param coordinates num_cells x ((gdim + 1) * gdim) vertex coordinates
+    //! @param dofs num_cells x (gdim * num_shape_functions) displacement
+    //!        DOFs, component major, as local indices of the solution vector
+    //! @param weights num_points quadrature weights on the reference cell
+    //! @param ips num_cells x num_points IP numbers
+    BOperator(Constraint c, const RowMatrixXd& reference_gradients, const Eigen::VectorXd& weights,
+              const RowMatrixXd& coordinates, const RowMatrixXi& dofs, const RowMatrixXi& ips)
+        : _gdim(Dim::G(c))
+        , _q(Dim::Q(c))
+        , _dofs(dofs)
+        , _ips(ips)
+    {
+        const int num_cells = _dofs.rows();
+        const int num_points = _ips.cols();
+        _num_shape = reference_gradients.rows() / std::max(num_points, 1);
+
+        if (reference_gradients.cols() != _gdim or reference_gradients.rows() != num_points * _num_shape or
+            weights.size() != num_points)
+            throw std::runtime_error("The reference gradients do not match the number of points.");
+        if (coordinates.rows() != num_cells or coordinates.cols() != (_gdim + 1) * _gdim)
+            throw std::runtime_error("Expected the " + std::to_string(_gdim + 1) + " vertices of each cell.");
+        if (_dofs.cols() != _gdim * _num_shape or _ips.rows() != num_cells)
+            throw std::runtime_error("The dofs and ips do not match the reference gradients.");
+
+        _num_ips = num_cells == 0 ? 0 : _ips.maxCoeff() + 1;
+        _num_dofs = num_cells == 0 ? 0 : _dofs.maxCoeff() + 1;
+
+        // physical gradients dN/dx = dN/dxi * J^-1, with the Jacobian J of the
+        // affine map from the reference cell
+        _gradients.resize(_num_shape, _gdim * num_cells * num_points);
+        _weights.resize(num_cells * num_points);
+        Eigen::MatrixXd J(_gdim, _gdim);
+        for (int cell = 0; cell < num_cells; ++cell)
+        {
+            for (int j = 0; j < _gdim; ++j)
+                for (int i = 0; i < _gdim; ++i)
+                    J(i, j) = coordinates(cell, (j + 1) * _gdim + i) - coordinates(cell, i);
+
+            const Eigen::MatrixXd J_inv = J.inverse();
+            const double det_J = std::abs(J.determinant());
+            for (int k = 0; k < num_points; ++k)
+            {
+                _gradients.middleCols(_gdim * (cell * num_points + k), _gdim) =
+                        reference_gradients.middleRows(k * _num_shape, _num_shape) * J_inv;
+                _weights[cell * num_points + k] = weights[k] * det_J;
+            }
+        }
+    }
+
+    int NumIPs() const
+    {
+        return _num_ips;
+    }
+
+    //! @brief strains of all IPs, stored IP by IP in `strains`
+    void Strains(const Eigen::Ref<const Eigen::VectorXd>& u, Eigen::Ref<Eigen::VectorXd> strains) const
+    {
+        if (strains.size() != _num_ips * _q)
+            throw std::runtime_error("Got " + std::to_string(strains.size()) + " strain values, expected " +
+                                     std::to_string(_num_ips) + " x " + std::to_string(_q) + ".");
+        ForEachIP(u, [&](int ip, const Eigen::VectorXd& eps) { strains.segment(_q * ip, _q) = eps; });
+    }
+
+    //! @brief writes the strains directly into the EPS input of `loop`
+    void Strains(const Eigen::Ref<const Eigen::VectorXd>& u, IpLoop& loop) const
+    {
+        QValues& eps_input = loop._inputs[EPS];
+        if (not eps_input.IsUsed() or eps_input._rows != _q or loop._n != _num_ips)
+            throw std::runtime_error("The IpLoop does not take " + std::to_string(_num_ips) + " x " +
+                                     std::to_string(_q) + " strains as input.");
+        ForEachIP(u, [&](int ip, const Eigen::VectorXd& eps) { eps_input.Set(eps, ip); });
+    }
+
+    //! @brief element residuals B^T * sigma and, if `tangents` is not empty,
+    //! element tangents B^T * dsigma/deps * B, both integrated over the cells
+    //! from the SIGMA and DSIGMA_DEPS outputs of `loop`.
+    //! @param residuals num_cells x (gdim * num_shape_functions)
+    //! @param tangents num_cells x (gdim * num_shape_functions)^2, each
+    //!        element matrix row by row
+    void Assemble(const IpLoop& loop, Eigen::Ref<RowMatrixXd> residuals, Eigen::Ref<RowMatrixXd> tangents) const
+    {
+        const int num_cells = _dofs.rows();
+        const int num_points = _ips.cols();
+        const int nd = _dofs.cols();
+        const bool with_tangents = tangents.size() != 0;
+
+        if (residuals.rows() != num_cells or residuals.cols() != nd)
+            throw std::runtime_error("Expected " + std::to_string(num_cells) + " x " + std::to_string(nd) +
+                                     " element residuals.");
+        if (with_tangents and (tangents.rows() != num_cells or tangents.cols() != nd * nd))
+            throw std::runtime_error("Expected " + std::to_string(num_cells) + " x " + std::to_string(nd * nd) +
+                                     " element tangents.");
+        if (loop._n != _num_ips or loop._outputs[SIGMA]._rows != _q or
+            (with_tangents and loop._outputs[DSIGMA_DEPS]._rows != _q))
+            throw std::runtime_error("The IpLoop does not provide " + std::to_string(_num_ips) + " stresses and " +
+                                     "tangents of size " + std::to_string(_q) + ".");
+
+        Eigen::MatrixXd B(_q, nd);
+        Eigen::VectorXd sigma(_q);
+        Eigen::MatrixXd dsigma(_q, _q);
+        Eigen::MatrixXd CB(_q, nd);
+        for (int cell = 0; cell < num_cells; ++cell)
+        {
+            auto r = residuals.row(cell);
+            r.setZero();
+            Eigen::Map<RowMatrixXd> K(tangents.data() + (with_tangents ? cell * nd * nd : 0), with_tangents ? nd : 0,
+                                      with_tangents ? nd : 0);
+            K.setZero();
+
+            for (int k = 0; k < num_points; ++k)
+            {
+                const int ip = _ips(cell, k);
+                const double w = _weights[cell * num_points + k];
+                FillB(cell * num_points + k, B);
+
+                loop._outputs[SIGMA].GetTo(ip, sigma);
+                r.noalias() += w * (B.transpose() * sigma).transpose();
+
+                if (not with_tangents)
+                    continue;
+                loop._outputs[DSIGMA_DEPS].GetTo(ip, dsigma);
+                CB.noalias() = dsigma * B;
+                K.noalias() += w * B.transpose() * CB;
+            }
+        }
+    }
+
+private:
+    //! @brief strain-displacement matrix of the point `cell * num_points + k`
+    void FillB(int point, Eigen::MatrixXd& B) const
+    {
+        const auto G = _gradients.middleCols(_gdim * point, _gdim);
+        const int n = _num_shape;
+        B.setZero();
+        for (int a = 0; a < n; ++a)
+        {
+            for (int i = 0; i < _gdim; ++i)
+                B(i, i * n + a) = G(a, i);
+            if (_gdim == 2)
+            {
+                B(2, a) = G(a, 1);
+                B(2, n + a) = G(a, 0);
+            }
+            if (_gdim == 3)
+            {
+                B(3, n + a) = G(a, 2);
+                B(3, 2 * n + a) = G(a, 1);
+                B(4, a) = G(a, 2);
+                B(4, 2 * n + a) = G(a, 0);
+                B(5, a) = G(a, 1);
+                B(5, n + a) = G(a, 0);
+            }
+        }
+    }
+
+    template <typename TF>
+    void ForEachIP(const Eigen::Ref<const Eigen::VectorXd>& u, TF&& f) const
+    {
+        const int num_cells = _dofs.rows();
+        const int num_points = _ips.cols();
+        if (u.size() < _num_dofs)
+            throw std::runtime_error("The displacement vector is too short for the dofs.");
+
+        // U(i, a) is the i-th component of the a-th shape function, H the
+        // displacement gradient du_i/dx_j.
+        Eigen::MatrixXd U(_gdim, _num_shape);
+        Eigen::MatrixXd H(_gdim, _gdim);
+        Eigen::VectorXd eps(_q);
+
+        for (int cell = 0; cell < num_cells; ++cell)
+        {
+            for (int i = 0; i < _gdim; ++i)
+                for (int a = 0; a < _num_shape; ++a)
+                    U(i, a) = u[_dofs(cell, i * _num_shape + a)];
+
+            for (int k = 0; k < num_points; ++k)
+            {
+                H.noalias() = U * _gradients.middleCols(_gdim * (cell * num_points + k), _gdim);
+                if (_gdim == 1)
+                    eps << H(0, 0);
+                else if (_gdim == 2)
+                    eps << H(0, 0), H(1, 1), H(0, 1) + H(1, 0);
+                else
+                    eps << H(0, 0), H(1, 1), H(2, 2), H(1, 2) + H(2, 1), H(0, 2) + H(2, 0), H(0, 1) + H(1, 0);
+                f(_ips(cell, k), eps);
+            }
+        }
+    }
+
+    int _gdim;
+    int _q;
+    int _num_shape;
+    int _num_ips;
+    int _num_dofs;
+    RowMatrixXi _dofs;
+    RowMatrixXi _ips;
+    Eigen::MatrixXd _gradients;
+    Eigen::VectorXd _weights;
+};
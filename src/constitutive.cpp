@@ -1,13 +1,80 @@
 #include <pybind11/eigen.h>
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include "interfaces.h"
+#include "autodiff.h"
+#include "b_operator.h"
 #include "linear_elastic.h"
 #include "local_damage.h"
 #include "plasticity.h"
+#include "tangent_check.h"
 
 namespace py = pybind11;
 
+//! @brief Passes the blocks as a dict {Q: numpy view} to a python
+//! `BlockLaw`. Vectors are shaped (num_ips, rows), scalars (num_ips,) and
+//! matrices (num_ips, rows, cols). The views are only valid during the call.
+class PyBlockLaw : public BlockLaw
+{
+public:
+    using BlockLaw::BlockLaw;
+
+    void EvaluateBlock(const std::vector<Block>& input, std::vector<Block>& out) override
+    {
+        py::gil_scoped_acquire gil;
+        py::function overload = py::get_overload(static_cast<const BlockLaw*>(this), "evaluate");
+        if (not overload)
+            throw std::runtime_error("A BlockLaw has to implement evaluate(inputs, outputs).");
+        overload(Arrays(input, false), Arrays(out, true));
+    }
+
+    void UpdateBlock(const std::vector<Block>& input) override
+    {
+        py::gil_scoped_acquire gil;
+        py::function overload = py::get_overload(static_cast<const BlockLaw*>(this), "update");
+        if (overload)
+            overload(Arrays(input, false));
+    }
+
+    void Resize(int n) override
+    {
+        PYBIND11_OVERLOAD_NAME(void, BlockLaw, "resize", Resize, n);
+    }
+
+private:
+    static py::dict Arrays(const std::vector<Block>& blocks, bool writable)
+    {
+        py::dict arrays;
+        for (unsigned iQ = 0; iQ < blocks.size(); ++iQ)
+        {
+            const Block& b = blocks[iQ];
+            if (b.rows == 0)
+                continue;
+
+            const py::ssize_t d = sizeof(double);
+            std::vector<py::ssize_t> shape{b.num_ips}, strides{d * b.stride};
+            if (b.rows * b.cols != 1)
+            {
+                shape.push_back(b.rows);
+                strides.push_back(d);
+            }
+            if (b.cols != 1)
+            {
+                shape.push_back(b.cols);
+                strides.push_back(d * b.rows);
+            }
+
+            // The (empty) base object prevents the copy of the data.
+            py::array_t<double> array(shape, strides, b.data, py::str());
+            if (not writable)
+                array.attr("setflags")(py::arg("write") = false);
+            arrays[py::cast(static_cast<Q>(iQ))] = array;
+        }
+        return arrays;
+    }
+};
+
 PYBIND11_MODULE(cpp, m)
 {
     // This was created with the help of
@@ -38,6 +105,16 @@ PYBIND11_MODULE(cpp, m)
             .value("DEEQ", Q::DEEQ)
             .value("DSIGMA_DE", Q::DSIGMA_DE);
 
+    pybind11::enum_<Precision>(m, "Precision").value("DOUBLE", Precision::DOUBLE).value("SINGLE", Precision::SINGLE);
+
+    pybind11::enum_<ArenaLayout>(m, "ArenaLayout")
+            .value("BLOCKED", ArenaLayout::BLOCKED)
+            .value("INTERLEAVED", ArenaLayout::INTERLEAVED);
+
+    pybind11::enum_<TangentMode>(m, "TangentMode")
+            .value("CONSISTENT", TangentMode::CONSISTENT)
+            .value("SECANT", TangentMode::SECANT);
+
     m.def("g_dim", &Dim::G);
     m.def("q_dim", &Dim::Q);
 
@@ -45,22 +122,133 @@ PYBIND11_MODULE(cpp, m)
      **   IPLOOP AND MAIN INTERFACES
      *************************************************************************/
 
-    pybind11::class_<IpLoop> ipLoop(m, "IpLoop");
+    pybind11::class_<IpLoop> ipLoop(m, "IpLoop",
+                                    "Evaluates its laws at all integration points. An IpLoop releases the GIL in its "
+                                    "material passes and must not be used by several python threads at once, "
+                                    "different IpLoops can.");
     ipLoop.def(pybind11::init<>());
+    // The shared_ptr alone would not keep the python part of a law, e.g.
+    // the `evaluate` of a `BlockLaw`, alive, so the loop references it.
     ipLoop.def("add_law", py::overload_cast<std::shared_ptr<MechanicsLaw>, std::vector<int>>(&IpLoop::AddLaw),
-               py::arg("law"), py::arg("ips") = std::vector<int>());
+               py::arg("law"), py::arg("ips") = std::vector<int>(), py::keep_alive<1, 2>());
     ipLoop.def("add_law", py::overload_cast<std::shared_ptr<LawInterface>, std::vector<int>>(&IpLoop::AddLaw),
-               py::arg("law"), py::arg("ips") = std::vector<int>());
-    ipLoop.def("evaluate", &IpLoop::Evaluate, py::arg("eps"), py::arg("e") = Eigen::VectorXd());
-    ipLoop.def("update", &IpLoop::Update, py::arg("eps"), py::arg("e") = Eigen::VectorXd());
-    ipLoop.def("resize", &IpLoop::Resize);
-    ipLoop.def("get", &IpLoop::Get);
+               py::arg("law"), py::arg("ips") = std::vector<int>(), py::keep_alive<1, 2>());
+
+    // The material passes are pure C++ and release the GIL such that other
+    // python threads keep running. Laws implemented in python have to
+    // reacquire it. Without the GIL, nothing serializes these calls against
+    // the other methods of the same loop, e.g. `add_law` or `set_precision`
+    // from another thread. One IpLoop belongs to one thread at a time.
+    using release_gil = py::call_guard<py::gil_scoped_release>;
+    using Inputs = const Eigen::Ref<const Eigen::VectorXd>&;
+    ipLoop.def("evaluate", py::overload_cast<Inputs, Inputs>(&IpLoop::Evaluate), py::arg("eps"),
+               py::arg("e") = Eigen::VectorXd(), release_gil());
+    ipLoop.def("evaluate", py::overload_cast<>(&IpLoop::Evaluate), release_gil());
+    ipLoop.def("update", py::overload_cast<Inputs, Inputs>(&IpLoop::Update), py::arg("eps"),
+               py::arg("e") = Eigen::VectorXd(), release_gil());
+    ipLoop.def("update", py::overload_cast<>(&IpLoop::Update), release_gil());
+    ipLoop.def("resize", &IpLoop::Resize, release_gil());
+    ipLoop.def("get", &IpLoop::Get, release_gil());
+    ipLoop.def("write_to", &IpLoop::WriteTo, py::arg("what"), py::arg("values"), release_gil());
+    ipLoop.def("set_precision", &IpLoop::SetPrecision, py::arg("what"), py::arg("precision"));
+    ipLoop.def("set_num_threads", &IpLoop::SetNumThreads, py::arg("num_threads"));
+    ipLoop.def("set_arena_layout", &IpLoop::SetArenaLayout, py::arg("layout"));
     ipLoop.def("required_inputs", &IpLoop::RequiredInputs);
+    ipLoop.def("set_incremental", &IpLoop::SetIncremental, py::arg("tolerance") = 0.);
+    ipLoop.def("dirty_fraction", &IpLoop::DirtyFraction);
+    ipLoop.def("memory", [](const IpLoop& loop) {
+        // {"q": {Q: bytes}, "histories": [bytes per law], ...}
+        const MemoryReport report = loop.Memory();
+        py::dict d;
+        d["q"] = report.q;
+        d["histories"] = report.histories;
+        d["padding"] = report.padding;
+        d["other"] = report.other;
+        d["total"] = report.total;
+        d["bytes_per_ip"] = report.bytes_per_ip;
+        return d;
+    });
+    ipLoop.def("set_compute_tangents", &IpLoop::SetComputeTangents, py::arg("compute"));
+    ipLoop.def("set_record_stats", &IpLoop::SetRecordStats, py::arg("record") = true);
+    ipLoop.def("reset_stats", &IpLoop::ResetStats);
+    ipLoop.def("stats", [](const IpLoop& loop) {
+        // {law index: {counter: value}}, in the order of `add_law`
+        py::dict all;
+        const auto& stats = loop.Stats();
+        for (unsigned iLaw = 0; iLaw < stats.size(); ++iLaw)
+        {
+            const LawStats& s = stats[iLaw];
+            py::dict d;
+            d["evaluate_time"] = s.evaluate_seconds;
+            d["update_time"] = s.update_seconds;
+            d["evaluate_calls"] = s.evaluate_calls;
+            d["update_calls"] = s.update_calls;
+            d["evaluated_ips"] = s.evaluated_ips;
+            d["updated_ips"] = s.updated_ips;
+            d["loading_ips"] = s.loading_ips;
+            d["unloading_ips"] = s.unloading_ips;
+            d["calls_per_step"] = s.update_calls == 0 ? 0. : static_cast<double>(s.evaluate_calls) / s.update_calls;
+            d["max_calls_per_step"] = s.max_evaluate_calls_per_step;
+            for (int e = 0; PerfCounters::Enabled() and e < PerfCounters::num_events; ++e)
+            {
+                d[py::str("evaluate_" + PerfCounters::Names()[e])] = s.evaluate_counters[e];
+                d[py::str("update_" + PerfCounters::Names()[e])] = s.update_counters[e];
+            }
+            all[py::int_(iLaw)] = d;
+        }
+        return all;
+    });
+
+    pybind11::class_<BOperator> bOperator(m, "BOperator");
+    bOperator.def(pybind11::init<Constraint, RowMatrixXd, Eigen::VectorXd, RowMatrixXd, RowMatrixXi, RowMatrixXi>(),
+                  py::arg("constraint"), py::arg("reference_gradients"), py::arg("weights"), py::arg("coordinates"),
+                  py::arg("dofs"), py::arg("ips"));
+    bOperator.def("num_ips", &BOperator::NumIPs);
+    bOperator.def("strains", py::overload_cast<Inputs, Eigen::Ref<Eigen::VectorXd>>(&BOperator::Strains, py::const_),
+                  py::arg("u"), py::arg("strains"), release_gil());
+    bOperator.def("strains", py::overload_cast<Inputs, IpLoop&>(&BOperator::Strains, py::const_), py::arg("u"),
+                  py::arg("iploop"), release_gil());
+    bOperator.def("assemble", &BOperator::Assemble, py::arg("iploop"), py::arg("residuals"),
+                  py::arg("tangents") = RowMatrixXd(), release_gil());
+
+    pybind11::class_<TangentErrors> tangentErrors(m, "TangentErrors");
+    tangentErrors.def_readonly("dsigma_deps", &TangentErrors::dsigma_deps);
+    tangentErrors.def_readonly("dsigma_de", &TangentErrors::dsigma_de);
+    tangentErrors.def_readonly("tangent_time", &TangentErrors::tangent_seconds);
+    tangentErrors.def_readonly("stress_time", &TangentErrors::stress_seconds);
+    tangentErrors.def_readonly("time", &TangentErrors::seconds);
+
+    m.def("check_tangents",
+          [](IpLoop& loop, Inputs eps, Inputs e, double delta) { return TangentCheck(loop, delta).Check(eps, e); },
+          py::arg("iploop"), py::arg("eps"), py::arg("e") = Eigen::VectorXd(), py::arg("delta") = 1.e-6,
+          release_gil());
+    m.def("check_tangents_random",
+          [](IpLoop& loop, double amplitude, unsigned seed, double delta) {
+              return TangentCheck(loop, delta).CheckRandom(amplitude, seed);
+          },
+          py::arg("iploop"), py::arg("amplitude") = 1.e-3, py::arg("seed") = 0, py::arg("delta") = 1.e-6,
+          release_gil());
+
+    // The tracer is a process wide singleton, so only static methods.
+    pybind11::class_<Tracer, std::unique_ptr<Tracer, py::nodelete>> tracer(m, "Tracer");
+    tracer.def_static("enable", [](bool enable) { Tracer::Instance().Enable(enable); }, py::arg("enable") = true);
+    tracer.def_static("enabled", []() { return Tracer::Instance().Enabled(); });
+    tracer.def_static("clear", []() { Tracer::Instance().Clear(); });
+    tracer.def_static("now", []() { return Tracer::Instance().Now(); });
+    tracer.def_static("complete", [](const std::string& name, double start) { Tracer::Instance().Complete(name, start); },
+                      py::arg("name"), py::arg("start"));
+    tracer.def_static("json", [](int pid) { return Tracer::Instance().Json(pid); }, py::arg("pid") = 0);
+    tracer.def_static("write", [](const std::string& filename, int pid) { Tracer::Instance().Write(filename, pid); },
+                      py::arg("filename"), py::arg("pid") = 0);
 
     pybind11::class_<LawInterface, std::shared_ptr<LawInterface>> law(m, "LawInterface");
 
+    pybind11::class_<BlockLaw, PyBlockLaw, std::shared_ptr<BlockLaw>, LawInterface> blockLaw(m, "BlockLaw");
+    blockLaw.def(pybind11::init<BlockLaw::Shapes, BlockLaw::Shapes>(), py::arg("inputs"), py::arg("outputs"));
+
     pybind11::class_<MechanicsLaw, std::shared_ptr<MechanicsLaw>> mechanicsLaw(m, "MechanicsLaw");
     mechanicsLaw.def("evaluate", &MechanicsLaw::Evaluate, py::arg("strain"), py::arg("i") = 0);
+    mechanicsLaw.def("evaluate_stress", &MechanicsLaw::EvaluateStress, py::arg("strain"), py::arg("i") = 0);
     mechanicsLaw.def("update", &MechanicsLaw::Update, py::arg("strain"), py::arg("i") = 0);
     mechanicsLaw.def("resize", &MechanicsLaw::Resize, py::arg("n"));
 
@@ -98,6 +286,9 @@ PYBIND11_MODULE(cpp, m)
     local.def(pybind11::init<double, double, Constraint, std::shared_ptr<DamageLawInterface>,
                              std ::shared_ptr<StrainNormInterface>>());
     local.def("kappa", &LocalDamage::Kappa);
+    local.def("set_impl_ex", &LocalDamage::SetImplEx, py::arg("impl_ex") = true);
+    local.def("set_step_ratio", &LocalDamage::SetStepRatio, py::arg("ratio"));
+    local.def("set_tangent_mode", &LocalDamage::SetTangentMode, py::arg("mode"));
 
     /*************************************************************************
      **   GRADIENT DAMAGE LAW
@@ -107,6 +298,27 @@ PYBIND11_MODULE(cpp, m)
     gdm.def(pybind11::init<double, double, Constraint, std::shared_ptr<DamageLawInterface>,
                            std ::shared_ptr<StrainNormInterface>>());
     gdm.def("kappa", &GradientDamage::Kappa);
+    gdm.def("set_impl_ex", &GradientDamage::SetImplEx, py::arg("impl_ex") = true);
+    gdm.def("set_step_ratio", &GradientDamage::SetStepRatio, py::arg("ratio"));
+    gdm.def("set_tangent_mode", &GradientDamage::SetTangentMode, py::arg("mode"));
+
+    /*************************************************************************
+     **   DAMAGE LAWS WITH AUTOMATIC DIFFERENTIATION
+     *************************************************************************/
+
+    pybind11::class_<AutoDiffLocalDamage, std::shared_ptr<AutoDiffLocalDamage>, LawInterface> adLocal(
+            m, "AutoDiffLocalDamage");
+    adLocal.def(pybind11::init<double, double, Constraint, std::shared_ptr<DamageLawExponential>,
+                               std::shared_ptr<ModMisesEeq>>(),
+                py::arg("E"), py::arg("nu"), py::arg("constraint"), py::arg("omega"), py::arg("strain_norm"));
+    adLocal.def("kappa", [](AutoDiffLocalDamage& law) { return law.Law().Kappa(); });
+
+    pybind11::class_<AutoDiffGradientDamage, std::shared_ptr<AutoDiffGradientDamage>, LawInterface> adGradient(
+            m, "AutoDiffGradientDamage");
+    adGradient.def(pybind11::init<double, double, Constraint, std::shared_ptr<DamageLawExponential>,
+                                  std::shared_ptr<ModMisesEeq>>(),
+                   py::arg("E"), py::arg("nu"), py::arg("constraint"), py::arg("omega"), py::arg("strain_norm"));
+    adGradient.def("kappa", [](AutoDiffGradientDamage& law) { return law.Law().Kappa(); });
 
     /*************************************************************************
      **   PLASTICITY
@@ -120,4 +332,14 @@ PYBIND11_MODULE(cpp, m)
     RateIndependentHistory.def(pybind11::init<>());
     RateIndependentHistory.def("__call__", &RateIndependentHistory::Call);
 //     RateIndependentHistory.def_readonly("P", &RateIndependentHistory::_p);
+
+    pybind11::class_<VonMisesPlasticity, std::shared_ptr<VonMisesPlasticity>, LawInterface> vonMises(
+            m, "VonMisesPlasticity");
+    vonMises.def(pybind11::init<double, double, Constraint, double, double>(), py::arg("E"), py::arg("nu"),
+                 py::arg("constraint"), py::arg("sig0"), py::arg("H"));
+    vonMises.def("set_return_mapping", &VonMisesPlasticity::SetReturnMapping, py::arg("tolerance") = 1.e-9,
+                 py::arg("max_iterations") = 20);
+    vonMises.def("set_max_substeps", &VonMisesPlasticity::SetMaxSubsteps, py::arg("max_substeps"));
+    vonMises.def("substeps", &VonMisesPlasticity::Substeps);
+    vonMises.def("kappa", &VonMisesPlasticity::Kappa);
 }
@@ -0,0 +1,275 @@
+#pragma once
+#include <eigen3/Eigen/Core>
+#include <array>
+#include <cmath>
+
+//! @brief Forward mode automatic differentiation: a value and its gradient
+//! w.r.t. N independent variables. The gradient is a fixed-size array, so
+//! duals live on the stack, also in `VectorQT<Dual<N>>`.
+//!
+//! Code that is generic in its scalar type T works for double and `Dual`,
+//! if it calls the math functions unqualified after `using std::exp;` etc.
+template <int N>
+struct Dual
+{
+    double value = 0.;
+    std::array<double, N> gradient{};
+
+    Dual() = default;
+
+    //! @brief a constant
+    Dual(double v)
+        : value(v)
+    {
+    }
+
+    //! @brief the independent variable `i` with the value `v`
+    static Dual Variable(double v, int i)
+    {
+        Dual x(v);
+        x.gradient[i] = 1.;
+        return x;
+    }
+
+    Dual& operator+=(const Dual& other)
+    {
+        value += other.value;
+        for (int i = 0; i < N; ++i)
+            gradient[i] += other.gradient[i];
+        return *this;
+    }
+
+    Dual& operator-=(const Dual& other)
+    {
+        value -= other.value;
+        for (int i = 0; i < N; ++i)
+            gradient[i] -= other.gradient[i];
+        return *this;
+    }
+
+    Dual& operator*=(const Dual& other)
+    {
+        for (int i = 0; i < N; ++i)
+            gradient[i] = gradient[i] * other.value + value * other.gradient[i];
+        value *= other.value;
+        return *this;
+    }
+
+    Dual& operator/=(const Dual& other)
+    {
+        const double inverse = 1. / other.value;
+        value *= inverse;
+        for (int i = 0; i < N; ++i)
+            gradient[i] = (gradient[i] - value * other.gradient[i]) * inverse;
+        return *this;
+    }
+
+    Dual& operator+=(double other)
+    {
+        value += other;
+        return *this;
+    }
+
+    Dual& operator-=(double other)
+    {
+        value -= other;
+        return *this;
+    }
+
+    Dual& operator*=(double other)
+    {
+        value *= other;
+        for (int i = 0; i < N; ++i)
+            gradient[i] *= other;
+        return *this;
+    }
+
+    Dual& operator/=(double other)
+    {
+        return *this *= 1. / other;
+    }
+};
+
+template <int N>
+Dual<N> operator-(Dual<N> x)
+{
+    return x *= -1.;
+}
+
+template <int N>
+Dual<N> operator+(Dual<N> a, const Dual<N>& b)
+{
+    return a += b;
+}
+
+template <int N>
+Dual<N> operator-(Dual<N> a, const Dual<N>& b)
+{
+    return a -= b;
+}
+
+template <int N>
+Dual<N> operator*(Dual<N> a, const Dual<N>& b)
+{
+    return a *= b;
+}
+
+template <int N>
+Dual<N> operator/(Dual<N> a, const Dual<N>& b)
+{
+    return a /= b;
+}
+
+template <int N>
+Dual<N> operator+(Dual<N> a, double b)
+{
+    return a += b;
+}
+
+template <int N>
+Dual<N> operator+(double a, Dual<N> b)
+{
+    return b += a;
+}
+
+template <int N>
+Dual<N> operator-(Dual<N> a, double b)
+{
+    return a -= b;
+}
+
+template <int N>
+Dual<N> operator-(double a, Dual<N> b)
+{
+    b *= -1.;
+    return b += a;
+}
+
+template <int N>
+Dual<N> operator*(Dual<N> a, double b)
+{
+    return a *= b;
+}
+
+template <int N>
+Dual<N> operator*(double a, Dual<N> b)
+{
+    return b *= a;
+}
+
+template <int N>
+Dual<N> operator/(Dual<N> a, double b)
+{
+    return a /= b;
+}
+
+template <int N>
+Dual<N> operator/(double a, const Dual<N>& b)
+{
+    return Dual<N>(a) /= b;
+}
+
+// Comparisons only consider the values, so branches (e.g. loading or
+// unloading) pick the derivative of the branch taken.
+#define CONSTITUTIVE_DUAL_COMPARISON(OP)                                                                               \
+    template <int N>                                                                                                   \
+    bool operator OP(const Dual<N>& a, const Dual<N>& b)                                                               \
+    {                                                                                                                  \
+        return a.value OP b.value;                                                                                     \
+    }                                                                                                                  \
+    template <int N>                                                                                                   \
+    bool operator OP(const Dual<N>& a, double b)                                                                       \
+    {                                                                                                                  \
+        return a.value OP b;                                                                                           \
+    }                                                                                                                  \
+    template <int N>                                                                                                   \
+    bool operator OP(double a, const Dual<N>& b)                                                                       \
+    {                                                                                                                  \
+        return a OP b.value;                                                                                           \
+    }
+
+CONSTITUTIVE_DUAL_COMPARISON(==)
+CONSTITUTIVE_DUAL_COMPARISON(!=)
+CONSTITUTIVE_DUAL_COMPARISON(<)
+CONSTITUTIVE_DUAL_COMPARISON(<=)
+CONSTITUTIVE_DUAL_COMPARISON(>)
+CONSTITUTIVE_DUAL_COMPARISON(>=)
+#undef CONSTITUTIVE_DUAL_COMPARISON
+
+//! @brief f(x) with the derivative `df` of f at x.value
+template <int N>
+Dual<N> Chain(const Dual<N>& x, double f, double df)
+{
+    Dual<N> result(f);
+    for (int i = 0; i < N; ++i)
+        result.gradient[i] = df * x.gradient[i];
+    return result;
+}
+
+template <int N>
+Dual<N> exp(const Dual<N>& x)
+{
+    const double f = std::exp(x.value);
+    return Chain(x, f, f);
+}
+
+template <int N>
+Dual<N> log(const Dual<N>& x)
+{
+    return Chain(x, std::log(x.value), 1. / x.value);
+}
+
+//! @brief The derivative at 0 is taken as 0, as for the hand-written
+//! tangents of norms like sqrt(x^T x) at x = 0.
+template <int N>
+Dual<N> sqrt(const Dual<N>& x)
+{
+    const double f = std::sqrt(x.value);
+    return Chain(x, f, f == 0. ? 0. : 0.5 / f);
+}
+
+template <int N>
+Dual<N> pow(const Dual<N>& x, double p)
+{
+    return Chain(x, std::pow(x.value, p), p * std::pow(x.value, p - 1.));
+}
+
+template <int N>
+Dual<N> abs(const Dual<N>& x)
+{
+    return x.value < 0. ? -x : x;
+}
+
+template <int N>
+Dual<N> sin(const Dual<N>& x)
+{
+    return Chain(x, std::sin(x.value), std::cos(x.value));
+}
+
+template <int N>
+Dual<N> cos(const Dual<N>& x)
+{
+    return Chain(x, std::cos(x.value), -std::sin(x.value));
+}
+
+namespace Eigen
+{
+template <int N>
+struct NumTraits<Dual<N>> : NumTraits<double>
+{
+    typedef Dual<N> Real;
+    typedef Dual<N> NonInteger;
+    typedef Dual<N> Nested;
+    typedef Dual<N> Literal;
+    enum
+    {
+        IsComplex = 0,
+        IsInteger = 0,
+        IsSigned = 1,
+        RequireInitialization = 1,
+        ReadCost = N + 1,
+        AddCost = N + 1,
+        MulCost = 2 * N + 1
+    };
+};
+} // namespace Eigen
@@ -4,6 +4,15 @@
 #include <vector>
 #include <numeric>
 #include <memory>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include "perf_counters.h"
+#include "trace.h"
 
 enum Constraint
 {
@@ -27,48 +36,279 @@ enum Q
     LAST
 };
 
+enum Precision
+{
+    DOUBLE,
+    SINGLE
+};
+
+enum Layout
+{
+    DENSE,
+    SYMMETRIC
+};
+
+//! @brief 64-byte aligned memory that is deep copied
+class AlignedBuffer
+{
+public:
+    static constexpr std::size_t alignment = 64;
+
+    AlignedBuffer() = default;
+
+    //! @brief Note that the memory is not initialized. This allows the
+    //! threads that will work on it to touch it first.
+    explicit AlignedBuffer(std::size_t bytes)
+        : _memory(static_cast<char*>(std::malloc(bytes + alignment)))
+        , _bytes(bytes)
+    {
+        if (not _memory)
+            throw std::bad_alloc();
+    }
+
+    AlignedBuffer(const AlignedBuffer& other)
+    {
+        if (not other._memory)
+            return;
+        AlignedBuffer copy(other._bytes);
+        std::memcpy(copy.Data(), other.Data(), other._bytes);
+        Swap(copy);
+    }
+
+    AlignedBuffer(AlignedBuffer&& other) noexcept
+    {
+        Swap(other);
+    }
+
+    AlignedBuffer& operator=(AlignedBuffer other) noexcept
+    {
+        Swap(other);
+        return *this;
+    }
+
+    void Swap(AlignedBuffer& other) noexcept
+    {
+        std::swap(_memory, other._memory);
+        std::swap(_bytes, other._bytes);
+    }
+
+    char* Data() const
+    {
+        const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(_memory.get());
+        return _memory.get() + (alignment - address % alignment) % alignment;
+    }
+
+    std::size_t Bytes() const
+    {
+        return _bytes;
+    }
+
+private:
+    struct Free
+    {
+        void operator()(char* memory) const
+        {
+            std::free(memory);
+        }
+    };
+    std::unique_ptr<char, Free> _memory;
+    std::size_t _bytes = 0;
+};
+
 class QValues
 {
 public:
     QValues() = default;
 
-    //! @brief stores n x rows x cols values where n is the number of IPs
-    QValues(int rows, int cols = 1)
+    //! @brief stores n x rows x cols values where n is the number of IPs. A
+    //! SYMMETRIC (rows x rows) matrix only stores its upper triangle.
+    QValues(int rows, int cols = 1, Layout layout = DENSE)
         : _rows(rows)
         , _cols(cols)
+        , _layout(layout)
     {
+        assert(layout == DENSE or rows == cols);
     }
 
+    //! @brief number of stored values per IP
+    int Size() const
+    {
+        if (_layout == SYMMETRIC)
+            return _rows * (_rows + 1) / 2;
+        return _rows * _cols;
+    }
+
+    //! @brief bytes per stored value
+    int ScalarBytes() const
+    {
+        return _precision == SINGLE ? sizeof(float) : sizeof(double);
+    }
+
+    //! @brief bytes of all stored values
+    std::size_t Bytes() const
+    {
+        return static_cast<std::size_t>(_n) * Size() * ScalarBytes();
+    }
+
+    //! @brief Allocates and zeroes own memory for n IPs. If the values are
+    //! already bound to external memory for n IPs, they are only zeroed.
     void Resize(int n)
     {
-        data.setZero(n * _rows * _cols);
+        if (_external and n == _n)
+        {
+            for (int i = 0; i < _n; ++i)
+                Zero(i);
+            return;
+        }
+        _external = nullptr;
+        _n = n;
+        _stride = Size();
+        _buffer = AlignedBuffer(Bytes());
+        std::memset(_buffer.Data(), 0, Bytes());
+    }
+
+    //! @brief Uses external memory, e.g. from the arena of an `IpLoop`, for n
+    //! IPs. The values of IP i start at `memory + i * stride` values.
+    void Bind(char* memory, int n, int stride)
+    {
+        assert(stride >= Size());
+        _buffer = AlignedBuffer();
+        _external = memory;
+        _n = n;
+        _stride = stride;
+    }
+
+    bool IsBound() const
+    {
+        return _external != nullptr;
+    }
+
+    bool IsBoundTo(const AlignedBuffer& buffer) const
+    {
+        return _external and _external >= buffer.Data() and _external < buffer.Data() + buffer.Bytes();
+    }
+
+    //! @brief Copies values that are bound to external memory into own
+    //! memory, e.g. before that memory is released.
+    void Own()
+    {
+        if (not _external)
+            return;
+        const std::size_t bytes = Size() * ScalarBytes();
+        AlignedBuffer buffer(Bytes());
+        for (int i = 0; i < _n; ++i)
+            std::memcpy(buffer.Data() + i * bytes, _external + static_cast<std::size_t>(i) * _stride * ScalarBytes(),
+                        bytes);
+        _buffer = std::move(buffer);
+        _external = nullptr;
+        _stride = Size();
+    }
+
+    void Zero(int i)
+    {
+        std::memset(Pointer<char>(0) + static_cast<std::size_t>(i) * _stride * ScalarBytes(), 0,
+                    Size() * ScalarBytes());
+    }
+
+    //! @brief number of stored values between two IPs
+    int Stride() const
+    {
+        return _stride;
+    }
+
+    //! @brief pointer to the values of IP i, T must match the precision
+    template <typename T>
+    T* Pointer(int i) const
+    {
+        char* memory = _external ? _external : _buffer.Data();
+        return reinterpret_cast<T*>(memory) + static_cast<std::size_t>(i) * _stride;
     }
 
     void Set(double value, int i)
     {
         assert(_rows == 1);
         assert(_cols == 1);
-        data[i] = value;
+        if (_precision == SINGLE)
+            *Pointer<float>(i) = value;
+        else
+            *Pointer<double>(i) = value;
     }
 
-    void Set(Eigen::MatrixXd value, int i)
+    void Set(const Eigen::Ref<const Eigen::MatrixXd>& value, int i)
     {
         assert(value.rows() == _rows);
         assert(value.cols() == _cols);
-        data.segment(_rows * _cols * i, _rows * _cols) = Eigen::Map<Eigen::VectorXd>(value.data(), value.size());
+        if (_precision == SINGLE)
+            Pack(Pointer<float>(i), value);
+        else
+            Pack(Pointer<double>(i), value);
     }
 
     double GetScalar(int i) const
     {
         assert(_rows == 1);
         assert(_cols == 1);
-        return data[i];
+        if (_precision == SINGLE)
+            return *Pointer<float>(i);
+        return *Pointer<double>(i);
     }
 
     Eigen::MatrixXd Get(int i) const
     {
-        Eigen::VectorXd ip_values = data.segment(_rows * _cols * i, _rows * _cols);
-        return Eigen::Map<Eigen::MatrixXd>(ip_values.data(), _rows, _cols);
+        Eigen::MatrixXd value(_rows, _cols);
+        GetTo(i, value);
+        return value;
+    }
+
+    //! @brief unpacks the values of IP i into the (rows x cols) `value`
+    //! without allocating
+    template <typename TMatrix>
+    void GetTo(int i, TMatrix& value) const
+    {
+        if (_precision == SINGLE)
+            Unpack(Pointer<float>(i), value);
+        else
+            Unpack(Pointer<double>(i), value);
+    }
+
+    //! @brief all n x rows x cols values in double precision, symmetric
+    //! matrices are unpacked
+    Eigen::VectorXd Values() const
+    {
+        Eigen::VectorXd values(static_cast<Eigen::Index>(_n) * _rows * _cols);
+        CopyTo(values);
+        return values;
+    }
+
+    //! @brief writes all n x rows x cols values in double precision to
+    //! `values`, e.g. directly into the memory of a PETSc vector
+    void CopyTo(Eigen::Ref<Eigen::VectorXd> values) const
+    {
+        const int size = _rows * _cols;
+        CheckSize(values.size());
+        if (_layout == DENSE and _precision == DOUBLE and _stride == size)
+        {
+            values = Eigen::Map<const Eigen::VectorXd>(Pointer<double>(0), values.size());
+            return;
+        }
+        for (int i = 0; i < _n; ++i)
+        {
+            Eigen::Map<Eigen::MatrixXd> value(values.data() + static_cast<std::size_t>(i) * size, _rows, _cols);
+            if (_precision == SINGLE)
+                Unpack(Pointer<float>(i), value);
+            else
+                Unpack(Pointer<double>(i), value);
+        }
+    }
+
+    //! @brief sets all n x rows x cols values
+    void SetValues(const Eigen::Ref<const Eigen::VectorXd>& values)
+    {
+        const int size = _rows * _cols;
+        CheckSize(values.size());
+        for (int i = 0; i < _n; ++i)
+            Set(Eigen::Map<const Eigen::MatrixXd>(values.data() + static_cast<std::size_t>(i) * size, _rows, _cols),
+                i);
     }
 
     bool IsUsed() const
@@ -80,7 +320,48 @@ public:
     // private:
     int _rows = 0;
     int _cols = 0;
-    Eigen::VectorXd data;
+    Layout _layout = DENSE;
+    Precision _precision = DOUBLE;
+
+private:
+    void CheckSize(Eigen::Index size) const
+    {
+        if (size != static_cast<Eigen::Index>(_n) * _rows * _cols)
+            throw std::runtime_error("Got " + std::to_string(size) + " values, expected " + std::to_string(_n) +
+                                     " x " + std::to_string(_rows * _cols) + ".");
+    }
+
+    template <typename T>
+    void Pack(T* storage, const Eigen::Ref<const Eigen::MatrixXd>& value)
+    {
+        if (_layout == DENSE)
+        {
+            Eigen::Map<Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>>(storage, _rows, _cols) = value.cast<T>();
+            return;
+        }
+        for (int row = 0; row < _rows; ++row)
+            for (int col = row; col < _cols; ++col)
+                *storage++ = static_cast<T>(value(row, col));
+    }
+
+    template <typename T, typename TMatrix>
+    void Unpack(const T* storage, TMatrix& value) const
+    {
+        if (_layout == DENSE)
+        {
+            value = Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>>(storage, _rows, _cols)
+                            .template cast<double>();
+            return;
+        }
+        for (int row = 0; row < _rows; ++row)
+            for (int col = row; col < _cols; ++col)
+                value(row, col) = value(col, row) = *storage++;
+    }
+
+    int _n = 0;
+    int _stride = 0;
+    AlignedBuffer _buffer;
+    char* _external = nullptr;
 };
 
 struct Dim
@@ -125,18 +406,66 @@ using V = Eigen::Matrix<double, Dim::Q(TC), 1>;
 template <Constraint TC>
 using M = Eigen::Matrix<double, Dim::Q(TC), Dim::Q(TC)>;
 
+//! @brief Vectors and matrices of at most Dim::Q(FULL) rows and columns.
+//! They live on the stack, so the hot path needs no heap allocations.
+using VectorQ = Eigen::Matrix<double, Eigen::Dynamic, 1, Eigen::ColMajor, 6, 1>;
+using MatrixQ = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor, 6, 6>;
+
+//! @brief as `VectorQ`, for any scalar type, e.g. a `Dual`
+template <typename T>
+using VectorQT = Eigen::Matrix<T, Eigen::Dynamic, 1, Eigen::ColMajor, 6, 1>;
+
+//! @brief A x for a double matrix A with at most 6 rows and a vector of any
+//! scalar type, without mixing scalar types within Eigen
+template <typename T, typename TMatrix>
+VectorQT<T> Multiply(const TMatrix& A, const VectorQT<T>& x)
+{
+    VectorQT<T> result(A.rows());
+    for (Eigen::Index row = 0; row < A.rows(); ++row)
+    {
+        result[row] = A(row, 0) * x[0];
+        for (Eigen::Index col = 1; col < A.cols(); ++col)
+            result[row] += A(row, col) * x[col];
+    }
+    return result;
+}
+
 
 struct LawInterface
 {
     virtual void DefineOutputs(std::vector<QValues>& out) const = 0;
     virtual void DefineInputs(std::vector<QValues>& input) const = 0;
     virtual void Evaluate(const std::vector<QValues>& input, std::vector<QValues>& out, int i) = 0;
+    //! @brief Only the outputs that enter the residual are required, the
+    //! tangents are not used. By default, everything is evaluated.
+    virtual void EvaluateWithoutTangents(const std::vector<QValues>& input, std::vector<QValues>& out, int i)
+    {
+        Evaluate(input, out, i);
+    }
     virtual void Update(const std::vector<QValues>& input, int i)
     {
     }
     virtual void Resize(int n)
     {
     }
+    //! @brief history values that an `IpLoop` may place in its arena
+    virtual std::vector<QValues*> History()
+    {
+        return {};
+    }
+    //! @brief Changes whenever the law would define other outputs, e.g. after
+    //! switching to a non-symmetric tangent. An `IpLoop` then defines the
+    //! outputs again and lays out its arena before the next `Evaluate`.
+    virtual int OutputsVersion() const
+    {
+        return 0;
+    }
+    //! @brief bytes the law keeps outside of its `History`, e.g. per IP
+    //! diagnostics, see `MemoryReport::other`
+    virtual std::size_t OtherBytes() const
+    {
+        return 0;
+    }
 };
 
 class MechanicsLaw
@@ -149,7 +478,29 @@ public:
 
     virtual std::pair<Eigen::VectorXd, Eigen::MatrixXd> Evaluate(const Eigen::VectorXd& strain, int i = 0) = 0;
 
-    virtual void Update(const Eigen::VectorXd& strain, int i = 0)
+    //! @brief stress only, laws may skip the computation of their tangent
+    virtual Eigen::VectorXd EvaluateStress(const Eigen::VectorXd& strain, int i = 0)
+    {
+        return Evaluate(strain, i).first;
+    }
+
+    //! @brief Writes the stress and, if `tangent` is not empty, the tangent
+    //! into the given memory. The built-in laws do not allocate here, the
+    //! default implementation does.
+    virtual void EvaluateTo(const Eigen::Ref<const Eigen::VectorXd>& strain, Eigen::Ref<Eigen::VectorXd> stress,
+                            Eigen::Ref<Eigen::MatrixXd> tangent, int i)
+    {
+        if (tangent.size() == 0)
+        {
+            stress = EvaluateStress(strain, i);
+            return;
+        }
+        const auto result = Evaluate(strain, i);
+        stress = result.first;
+        tangent = result.second;
+    }
+
+    virtual void Update(const Eigen::Ref<const Eigen::VectorXd>& strain, int i = 0)
     {
     }
 
@@ -157,6 +508,29 @@ public:
     {
     }
 
+    virtual std::vector<QValues*> History()
+    {
+        return {};
+    }
+
+    //! @brief Laws with a symmetric tangent can store it packed.
+    virtual bool SymmetricTangent() const
+    {
+        return false;
+    }
+
+    //! @brief see `LawInterface::OutputsVersion`
+    virtual int OutputsVersion() const
+    {
+        return 0;
+    }
+
+    //! @brief see `LawInterface::OtherBytes`
+    virtual std::size_t OtherBytes() const
+    {
+        return 0;
+    }
+
     const Constraint _constraint;
 };
 
@@ -172,7 +546,7 @@ public:
     {
         const int q = Dim::Q(_law->_constraint);
         out[SIGMA] = QValues(q);
-        out[DSIGMA_DEPS] = QValues(q, q);
+        out[DSIGMA_DEPS] = QValues(q, q, _law->SymmetricTangent() ? SYMMETRIC : DENSE);
     }
 
     void DefineInputs(std::vector<QValues>& input) const override
@@ -182,23 +556,237 @@ public:
 
     void Evaluate(const std::vector<QValues>& input, std::vector<QValues>& out, int i) override
     {
-        auto eval = _law->Evaluate(input[EPS].Get(i), i);
-        out[SIGMA].Set(eval.first, i);
-        out[DSIGMA_DEPS].Set(eval.second, i);
+        const int q = Dim::Q(_law->_constraint);
+        VectorQ strain(q), stress(q);
+        MatrixQ tangent(q, q);
+        input[EPS].GetTo(i, strain);
+        _law->EvaluateTo(strain, stress, tangent, i);
+        out[SIGMA].Set(stress, i);
+        out[DSIGMA_DEPS].Set(tangent, i);
+    }
+    void EvaluateWithoutTangents(const std::vector<QValues>& input, std::vector<QValues>& out, int i) override
+    {
+        const int q = Dim::Q(_law->_constraint);
+        VectorQ strain(q), stress(q);
+        MatrixQ no_tangent(0, 0);
+        input[EPS].GetTo(i, strain);
+        _law->EvaluateTo(strain, stress, no_tangent, i);
+        out[SIGMA].Set(stress, i);
     }
     void Update(const std::vector<QValues>& input, int i) override
     {
-        _law->Update(input[EPS].Get(i), i);
+        VectorQ strain(Dim::Q(_law->_constraint));
+        input[EPS].GetTo(i, strain);
+        _law->Update(strain, i);
     }
     void Resize(int n) override
     {
         _law->Resize(n);
     }
+    std::vector<QValues*> History() override
+    {
+        return _law->History();
+    }
+    int OutputsVersion() const override
+    {
+        return _law->OutputsVersion();
+    }
+    std::size_t OtherBytes() const override
+    {
+        return _law->OtherBytes();
+    }
 
 private:
     std::shared_ptr<MechanicsLaw> _law;
 };
 
+//! @brief (rows x cols) values of `num_ips` IPs of a `BlockLaw`. IP k starts
+//! at `data + k * stride`, each value is stored column major.
+struct Block
+{
+    double* data = nullptr;
+    int num_ips = 0;
+    int rows = 0;
+    int cols = 0;
+    int stride = 0;
+};
+
+//! @brief A law that evaluates all of its IPs in one call, e.g. implemented
+//! in python on numpy arrays. Row k of each block belongs to the k-th IP of
+//! the law. The blocks are views of the IpLoop storage if its values are
+//! dense, double precision and the IPs of the law are consecutive, otherwise
+//! they are gathered into (and scattered from) buffers of the law.
+//!
+//! A block law is always evaluated completely and by a single thread.
+class BlockLaw : public LawInterface
+{
+public:
+    using Shapes = std::map<Q, std::pair<int, int>>;
+
+    //! @param inputs, outputs (rows, cols) of each used Q
+    BlockLaw(Shapes inputs, Shapes outputs)
+        : _input_shapes(inputs)
+        , _output_shapes(outputs)
+    {
+    }
+
+    virtual void EvaluateBlock(const std::vector<Block>& input, std::vector<Block>& out) = 0;
+
+    virtual void UpdateBlock(const std::vector<Block>& input)
+    {
+    }
+
+    void DefineOutputs(std::vector<QValues>& out) const override
+    {
+        for (const auto& shape : _output_shapes)
+            out[shape.first] = QValues(shape.second.first, shape.second.second);
+    }
+
+    void DefineInputs(std::vector<QValues>& input) const override
+    {
+        for (const auto& shape : _input_shapes)
+            input[shape.first] = QValues(shape.second.first, shape.second.second);
+    }
+
+    void Evaluate(const std::vector<QValues>& input, std::vector<QValues>& out, int i) override
+    {
+        EvaluateIPs(input, out, {i});
+    }
+
+    void Update(const std::vector<QValues>& input, int i) override
+    {
+        UpdateIPs(input, {i});
+    }
+
+    void EvaluateIPs(const std::vector<QValues>& input, std::vector<QValues>& out, const std::vector<int>& ips)
+    {
+        std::vector<Block> input_blocks = Blocks(input, _input_shapes, ips, true);
+        std::vector<Block> output_blocks = Blocks(out, _output_shapes, ips, false);
+        EvaluateBlock(input_blocks, output_blocks);
+
+        for (const auto& shape : _output_shapes)
+        {
+            const Block& block = output_blocks[shape.first];
+            if (IsView(out[shape.first], ips, block))
+                continue;
+            for (unsigned k = 0; k < ips.size(); ++k)
+                out[shape.first].Set(Eigen::Map<const Eigen::MatrixXd>(block.data + k * block.stride, block.rows,
+                                                                       block.cols),
+                                     ips[k]);
+        }
+    }
+
+    void UpdateIPs(const std::vector<QValues>& input, const std::vector<int>& ips)
+    {
+        UpdateBlock(Blocks(input, _input_shapes, ips, true));
+    }
+
+    //! @brief the buffers of the blocks that are not views
+    std::size_t OtherBytes() const override
+    {
+        std::size_t bytes = 0;
+        for (const auto& buffer : _buffers)
+            bytes += buffer.size() * sizeof(double);
+        return bytes;
+    }
+
+private:
+    static bool Consecutive(const std::vector<int>& ips)
+    {
+        for (unsigned k = 1; k < ips.size(); ++k)
+            if (ips[k] != ips[0] + static_cast<int>(k))
+                return false;
+        return true;
+    }
+
+    static bool IsView(const QValues& values, const std::vector<int>& ips, const Block& block)
+    {
+        return not ips.empty() and block.data == values.Pointer<double>(ips[0]);
+    }
+
+    std::vector<Block> Blocks(const std::vector<QValues>& values, const Shapes& shapes, const std::vector<int>& ips,
+                              bool gather)
+    {
+        const int n = ips.size();
+        std::vector<Block> blocks(Q::LAST);
+        _buffers.resize(2 * Q::LAST);
+        for (const auto& shape : shapes)
+        {
+            const QValues& q = values[shape.first];
+            Block& block = blocks[shape.first];
+            block.num_ips = n;
+            block.rows = q._rows;
+            block.cols = q._cols;
+
+            if (n != 0 and q._layout == DENSE and q._precision == DOUBLE and Consecutive(ips))
+            {
+                block.data = q.Pointer<double>(ips[0]);
+                block.stride = q.Stride();
+                continue;
+            }
+
+            std::vector<double>& buffer = _buffers[shape.first + (gather ? 0 : Q::LAST)];
+            block.stride = q._rows * q._cols;
+            buffer.resize(static_cast<std::size_t>(n) * block.stride);
+            block.data = buffer.data();
+            if (not gather)
+                continue;
+            for (int k = 0; k < n; ++k)
+            {
+                Eigen::Map<Eigen::MatrixXd> value(block.data + k * block.stride, q._rows, q._cols);
+                q.GetTo(ips[k], value);
+            }
+        }
+        return blocks;
+    }
+
+    Shapes _input_shapes;
+    Shapes _output_shapes;
+    std::vector<std::vector<double>> _buffers;
+};
+
+enum ArenaLayout
+{
+    BLOCKED,
+    INTERLEAVED
+};
+
+//! @brief What an `IpLoop` recorded for one of its laws. IPs whose history
+//! changed in an `Update` count as loading, the others as unloading. The
+//! hardware counters are only recorded if `PerfCounters::Enabled()`.
+struct LawStats
+{
+    double evaluate_seconds = 0.;
+    double update_seconds = 0.;
+    long evaluate_calls = 0;
+    long update_calls = 0;
+    long evaluated_ips = 0;
+    long updated_ips = 0;
+    long loading_ips = 0;
+    long unloading_ips = 0;
+    //! most `Evaluate` calls, e.g. Newton iterations, between two `Update`s
+    long max_evaluate_calls_per_step = 0;
+    PerfCounters::Values evaluate_counters = {};
+    PerfCounters::Values update_counters = {};
+};
+
+
+//! @brief Bytes of an `IpLoop`, see `IpLoop::Memory`
+struct MemoryReport
+{
+    //! @brief inputs and outputs per used Q
+    std::map<Q, std::size_t> q;
+    //! @brief history per law, in the order of `AddLaw`
+    std::vector<std::size_t> histories;
+    //! @brief alignment of the blocks in the arena
+    std::size_t padding = 0;
+    //! @brief outside of the arena: copies of the inputs (`SetIncremental`)
+    //! and of the histories (`SetRecordStats`), the IPs and dirty flags of
+    //! the loop and the `LawInterface::OtherBytes` of all laws
+    std::size_t other = 0;
+    std::size_t total = 0;
+    double bytes_per_ip = 0.;
+};
 
 class IpLoop
 {
@@ -207,17 +795,26 @@ public:
     {
         _outputs.resize(Q::LAST);
         _inputs.resize(Q::LAST);
+        _precision.resize(Q::LAST, DOUBLE);
     }
 
+    // The QValues point into the arena.
+    IpLoop(const IpLoop&) = delete;
+    IpLoop& operator=(const IpLoop&) = delete;
+
     void AddLaw(std::shared_ptr<LawInterface> law, std::vector<int> ips)
     {
+        CheckHistory(*law);
         _laws.push_back(law);
         _ips.push_back(ips);
         law->DefineInputs(_inputs);
-        law->DefineOutputs(_outputs);
+        DefineOutputs();
 
         if (_n != 0)
             Resize(_n);
+        _last_inputs.clear();
+        _ips_checked = false;
+        _stats.resize(_laws.size());
     }
 
     void AddLaw(std::shared_ptr<MechanicsLaw> law, std::vector<int> ips)
@@ -226,19 +823,170 @@ public:
         AddLaw(law_interface, ips);
     }
 
+    //! @brief Carves all inputs, outputs and law histories for n IPs from a
+    //! single arena and zeroes them, i.e. the laws start from their virgin
+    //! state. BLOCKED places the values of each Q next to each other,
+    //! INTERLEAVED groups all double precision inputs and outputs per IP.
+    //!
+    //! The outputs are defined again, so a law may choose e.g. the storage
+    //! of its tangent. Later changes are picked up by `Evaluate`, see
+    //! `LawInterface::OutputsVersion`.
+    //!
+    //! A law can only be used by one `IpLoop` at a time, which owns its
+    //! history. The history is copied back to the law when the loop is
+    //! destroyed, so the law remains usable.
     virtual void Resize(int n)
     {
         _n = n;
-        for (auto& qvalues : _outputs)
-            qvalues.Resize(n);
-
+        DefineOutputs();
+        Layout();
         for (auto& law : _laws)
             law->Resize(_n);
+
+        _last_inputs.clear();
+        _ips_checked = false;
+    }
+
+    virtual ~IpLoop()
+    {
+        for (auto& law : _laws)
+            for (QValues* history : law->History())
+                if (history->IsBoundTo(_arena))
+                    history->Own();
+    }
+
+    //! @brief Number of threads used in `Evaluate` and `Update`, only
+    //! effective if compiled with OpenMP. The arena is laid out again, so the
+    //! new threads touch their IPs first. All values, including the histories,
+    //! are kept.
+    void SetNumThreads(int num_threads)
+    {
+        const auto values = SaveValues();
+        _num_threads = num_threads;
+        RestoreValues(values);
+    }
+
+    int NumThreads() const
+    {
+        return _num_threads;
+    }
+
+    //! @brief keeps all values, including the histories
+    void SetArenaLayout(ArenaLayout layout)
+    {
+        const auto values = SaveValues();
+        _arena_layout = layout;
+        RestoreValues(values);
+    }
+
+    //! @brief Only re-evaluates IPs whose inputs changed by more than `tolerance`
+    //! (max norm) since the last `Evaluate`. A negative tolerance disables it.
+    void SetIncremental(double tolerance)
+    {
+        _tolerance = tolerance;
+        _last_inputs.clear();
+    }
+
+    //! @brief Skips the tangent outputs (e.g. DSIGMA_DEPS) in `Evaluate` if
+    //! they are not needed, e.g. in a modified Newton iteration. They are
+    //! outdated afterwards.
+    void SetComputeTangents(bool compute)
+    {
+        _compute_tangents = compute;
+    }
+
+    //! @brief Records the time and the IPs per law in `Evaluate` and `Update`.
+    //! That costs two clock reads per law and call, the loading IPs are
+    //! counted from copies of the history in `Update` only.
+    void SetRecordStats(bool record)
+    {
+        _record_stats = record;
+        OpenPerfCounters();
+    }
+
+    const std::vector<LawStats>& Stats() const
+    {
+        return _stats;
+    }
+
+    void ResetStats()
+    {
+        _stats.assign(_laws.size(), LawStats());
+        _evaluate_calls_in_step = 0;
+    }
+
+    //! @brief bytes of the arena, i.e. of all inputs, outputs and law histories
+    std::size_t Bytes() const
+    {
+        return _arena.Bytes();
+    }
+
+    //! @brief Bytes of the inputs and outputs per Q, of the history per law
+    //! and in total, e.g. to compare storage modes. The total grows linearly
+    //! with the number of IPs, so `bytes_per_ip` sizes larger problems.
+    MemoryReport Memory() const
+    {
+        MemoryReport report;
+        std::size_t used = 0;
+        for (const auto* qs : {&_inputs, &_outputs})
+            for (unsigned iQ = 0; iQ < qs->size(); ++iQ)
+                if ((*qs)[iQ].IsUsed())
+                {
+                    report.q[static_cast<Q>(iQ)] += (*qs)[iQ].Bytes();
+                    used += (*qs)[iQ].Bytes();
+                }
+        for (const auto& law : _laws)
+        {
+            std::size_t bytes = 0;
+            for (const QValues* history : law->History())
+                bytes += history->Bytes();
+            report.histories.push_back(bytes);
+            used += bytes;
+        }
+        report.padding = _arena.Bytes() > used ? _arena.Bytes() - used : 0;
+
+        for (const auto& values : _last_inputs)
+            report.other += values.size() * sizeof(double);
+        for (const auto* copies : {&_history_before, &_history_after})
+            for (const auto& values : *copies)
+                report.other += values.size() * sizeof(double);
+        for (const auto& ips : _ips)
+            report.other += ips.size() * sizeof(int);
+        report.other += (_dirty.size() + 7) / 8;
+        for (const auto& law : _laws)
+            report.other += law->OtherBytes();
+
+        report.total = _arena.Bytes() + report.other;
+        report.bytes_per_ip = _n == 0 ? 0. : static_cast<double>(report.total) / _n;
+        return report;
+    }
+
+    //! @brief fraction of IPs that were actually evaluated in the last `Evaluate`
+    double DirtyFraction() const
+    {
+        return _dirty_fraction;
+    }
+
+    //! @brief Stores the output `what` in the given precision. The laws still
+    //! compute in double precision, the values are converted when set. All
+    //! other values, including the histories, are kept.
+    void SetPrecision(Q what, Precision precision)
+    {
+        const auto values = SaveValues();
+        _precision.at(what) = precision;
+        _outputs[what]._precision = precision;
+        RestoreValues(values);
     }
 
     Eigen::VectorXd Get(Q what)
     {
-        return _outputs.at(what).data;
+        return _outputs.at(what).Values();
+    }
+
+    //! @brief writes the output `what` into `values` without a temporary
+    void WriteTo(Q what, Eigen::Ref<Eigen::VectorXd> values) const
+    {
+        _outputs.at(what).CopyTo(values);
     }
 
     std::vector<Q> RequiredInputs() const
@@ -253,35 +1001,94 @@ public:
         return required;
     }
 
-    virtual void Evaluate(const Eigen::VectorXd& all_strains, const Eigen::VectorXd& all_neeq)
+    virtual void Evaluate(const Eigen::Ref<const Eigen::VectorXd>& all_strains,
+                          const Eigen::Ref<const Eigen::VectorXd>& all_neeq)
+    {
+        SetInputs(all_strains, all_neeq);
+        Evaluate();
+    }
+
+    //! @brief evaluates the inputs that are already set, e.g. by the `BOperator`
+    virtual void Evaluate()
     {
-        FixIPs();
+        TraceScope trace("IpLoop::Evaluate");
+        OpenPerfCounters();
 
-        _inputs[E].data = all_neeq;
-        _inputs[EPS].data = all_strains;
+        // IPs that were skipped incrementally may have outdated tangents.
+        if (_compute_tangents and not _tangents_current)
+            _last_inputs.clear();
+
+        {
+            TraceScope prepare("check and mark IPs");
+            CheckOutputs();
+            FixIPs();
+            MarkDirtyIPs();
+        }
+
+        ++_evaluate_calls_in_step;
         for (unsigned iLaw = 0; iLaw < _laws.size(); ++iLaw)
-            for (int ip : _ips[iLaw])
-                _laws[iLaw]->Evaluate(_inputs, _outputs, ip);
+        {
+            LawInterface& law = *_laws[iLaw];
+            const Snapshot start = _record_stats ? Now() : Snapshot();
+            TraceScope batch("evaluate", iLaw);
+            if (auto* block_law = dynamic_cast<BlockLaw*>(&law))
+                block_law->EvaluateIPs(_inputs, _outputs, _ips[iLaw]);
+            else
+                ForEachIP(iLaw, [&](int ip) {
+                    if (not _dirty[ip])
+                        return;
+                    if (_compute_tangents)
+                        law.Evaluate(_inputs, _outputs, ip);
+                    else
+                        law.EvaluateWithoutTangents(_inputs, _outputs, ip);
+                });
+            if (_record_stats)
+                RecordEvaluate(iLaw, start);
+        }
+        _tangents_current = _compute_tangents;
     }
 
-    virtual void Update(const Eigen::VectorXd& all_strains, const Eigen::VectorXd& all_neeq)
+    virtual void Update(const Eigen::Ref<const Eigen::VectorXd>& all_strains,
+                        const Eigen::Ref<const Eigen::VectorXd>& all_neeq)
     {
-        _inputs[E].data = all_neeq;
-        _inputs[EPS].data = all_strains;
-        for (unsigned iLaw = 0; iLaw < _laws.size(); ++iLaw)
-            for (int ip : _ips[iLaw])
-                _laws[iLaw]->Update(_inputs, ip);
+        SetInputs(all_strains, all_neeq);
+        Update();
     }
 
-    std::vector<std::shared_ptr<LawInterface>> _laws;
-    std::vector<std::vector<int>> _ips;
-    std::vector<QValues> _outputs;
-    std::vector<QValues> _inputs;
-    int _n = 0;
+    //! @brief updates with the inputs that are already set
+    virtual void Update()
+    {
+        TraceScope trace("IpLoop::Update");
+        OpenPerfCounters();
 
-private:
+        for (unsigned iLaw = 0; iLaw < _laws.size(); ++iLaw)
+        {
+            LawInterface& law = *_laws[iLaw];
+            if (_record_stats)
+                CopyHistory(law, _history_before);
+            const Snapshot start = _record_stats ? Now() : Snapshot();
+            TraceScope batch("update", iLaw);
+
+            if (auto* block_law = dynamic_cast<BlockLaw*>(&law))
+                block_law->UpdateIPs(_inputs, _ips[iLaw]);
+            else
+                ForEachIP(iLaw, [&](int ip) { law.Update(_inputs, ip); });
+            if (_record_stats)
+                RecordUpdate(iLaw, start);
+        }
+        _evaluate_calls_in_step = 0;
+
+        // The history changed, so the outputs of all IPs are outdated.
+        _last_inputs.clear();
+    }
+
+    //! @brief Assigns all IPs to a single law that was added without IPs and
+    //! checks that each IP has exactly one law. Done by `Evaluate`.
     void FixIPs()
     {
+        if (_ips_checked)
+            return;
+
         // Actually, there is only one case to fix:
         if (_laws.size() == 1 and _ips[0].empty())
         {
@@ -316,6 +1123,391 @@ private:
                 throw std::runtime_error("Ip has no law!");
             }
         }
+        _ips_checked = true;
     }
+
+    std::vector<std::shared_ptr<LawInterface>> _laws;
+    std::vector<std::vector<int>> _ips;
+    std::vector<QValues> _outputs;
+    std::vector<QValues> _inputs;
+    int _n = 0;
+
+private:
+    //! @brief the outputs of all laws. An output shared by multiple laws is
+    //! only packed if all of them agree on that.
+    void DefineOutputs()
+    {
+        _outputs.assign(Q::LAST, QValues());
+        _outputs_versions.clear();
+        for (auto& law : _laws)
+        {
+            _outputs_versions.push_back(law->OutputsVersion());
+            std::vector<QValues> outputs(Q::LAST);
+            law->DefineOutputs(outputs);
+            for (unsigned iQ = 0; iQ < _outputs.size(); ++iQ)
+            {
+                if (not outputs[iQ].IsUsed())
+                    continue;
+                if (_outputs[iQ].IsUsed() and _outputs[iQ]._layout != outputs[iQ]._layout)
+                    outputs[iQ]._layout = DENSE;
+                _outputs[iQ] = outputs[iQ];
+                _outputs[iQ]._precision = _precision[iQ];
+            }
+        }
+    }
+
+    //! @brief Defines the outputs again and lays out the arena if a law
+    //! changed them since, e.g. its tangent can no longer be stored packed.
+    //! All values, including the histories, are kept.
+    void CheckOutputs()
+    {
+        for (unsigned iLaw = 0; iLaw < _laws.size(); ++iLaw)
+            if (_laws[iLaw]->OutputsVersion() != _outputs_versions[iLaw])
+            {
+                const auto values = SaveValues();
+                DefineOutputs();
+                RestoreValues(values);
+                return;
+            }
+    }
+
+    //! @brief throws if the history of `law` lives in the arena of another loop
+    void CheckHistory(LawInterface& law) const
+    {
+        for (const QValues* history : law.History())
+            if (history->IsBound() and history->Bytes() != 0 and not history->IsBoundTo(_arena))
+                throw std::runtime_error("A law can only be used by one IpLoop at a time.");
+    }
+
+    //! @brief allocates the arena for `_n` IPs, binds all inputs, outputs
+    //! and histories to it and zeroes them by the threads that evaluate them
+    //! (first touch)
+    void Layout()
+    {
+        for (auto& law : _laws)
+            CheckHistory(*law);
+
+        const int n = _n;
+        auto align = [](std::size_t bytes) {
+            return (bytes + AlignedBuffer::alignment - 1) / AlignedBuffer::alignment * AlignedBuffer::alignment;
+        };
+
+        std::vector<QValues*> interleaved, blocked;
+        for (auto* qs : {&_inputs, &_outputs})
+            for (auto& qvalues : *qs)
+                if (qvalues.IsUsed())
+                {
+                    if (_arena_layout == INTERLEAVED and qvalues._precision == DOUBLE)
+                        interleaved.push_back(&qvalues);
+                    else
+                        blocked.push_back(&qvalues);
+                }
+        for (auto& law : _laws)
+            for (QValues* history : law->History())
+                blocked.push_back(history);
+
+        int record = 0;
+        for (const QValues* qvalues : interleaved)
+            record += qvalues->Size();
+
+        std::size_t bytes = align(sizeof(double) * record * n);
+        for (const QValues* qvalues : blocked)
+            bytes += align(qvalues->ScalarBytes() * qvalues->Size() * static_cast<std::size_t>(n));
+
+        _arena = AlignedBuffer(bytes);
+        char* memory = _arena.Data();
+        int offset = 0;
+        for (QValues* qvalues : interleaved)
+        {
+            qvalues->Bind(memory + sizeof(double) * offset, n, record);
+            offset += qvalues->Size();
+        }
+        memory += align(sizeof(double) * record * n);
+        for (QValues* qvalues : blocked)
+        {
+            qvalues->Bind(memory, n, qvalues->Size());
+            memory += align(qvalues->ScalarBytes() * qvalues->Size() * static_cast<std::size_t>(n));
+        }
+
+        std::vector<QValues*> all = interleaved;
+        all.insert(all.end(), blocked.begin(), blocked.end());
+        Touch(all);
+    }
+
+    //! @brief Zeroes all values. The IPs of each law are touched first in
+    //! the static schedule of `ForEachIP`, so by the threads that evaluate
+    //! them. The IPs of a `BlockLaw`, which evaluates serially, and IPs
+    //! without a law, which `FixIPs` rejects later, are zeroed serially.
+    void Touch(const std::vector<QValues*>& all)
+    {
+        const int n = _n;
+        auto zero = [&](int ip) {
+            for (QValues* qvalues : all)
+                qvalues->Zero(ip);
+        };
+
+        // the IPs that `FixIPs` will assign
+        std::vector<std::vector<int>> ips = _ips;
+        if (ips.size() == 1 and ips[0].empty())
+        {
+            ips[0].resize(n);
+            std::iota(ips[0].begin(), ips[0].end(), 0);
+        }
+
+        std::vector<int> owner(n, -1);
+        for (unsigned iLaw = 0; iLaw < ips.size(); ++iLaw)
+            if (not dynamic_cast<BlockLaw*>(_laws[iLaw].get()))
+                for (int ip : ips[iLaw])
+                    if (ip >= 0 and ip < n and owner[ip] == -1)
+                        owner[ip] = iLaw;
+
+        for (int ip = 0; ip < n; ++ip)
+            if (owner[ip] == -1)
+                zero(ip);
+
+        for (unsigned iLaw = 0; iLaw < ips.size(); ++iLaw)
+        {
+            const std::vector<int>& law_ips = ips[iLaw];
+            const int num_ips = law_ips.size();
+            const int law = iLaw;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(_num_threads)
+#endif
+            for (int k = 0; k < num_ips; ++k)
+            {
+                const int ip = law_ips[k];
+                if (ip >= 0 and ip < n and owner[ip] == law)
+                    zero(ip);
+            }
+        }
+    }
+
+    //! @brief copies of all values in the arena, in double precision
+    std::vector<Eigen::VectorXd> SaveValues()
+    {
+        std::vector<Eigen::VectorXd> values;
+        if (_n == 0)
+            return values;
+        for (auto* qs : {&_inputs, &_outputs})
+            for (auto& qvalues : *qs)
+                if (qvalues.IsUsed())
+                    values.push_back(qvalues.Values());
+        for (auto& law : _laws)
+            for (QValues* history : law->History())
+                values.push_back(history->Values());
+        return values;
+    }
+
+    //! @brief lays out the arena again, e.g. for other threads or
+    //! precisions, and restores the `SaveValues` into it
+    void RestoreValues(const std::vector<Eigen::VectorXd>& values)
+    {
+        if (_n == 0)
+            return;
+        Layout();
+        auto value = values.begin();
+        for (auto* qs : {&_inputs, &_outputs})
+            for (auto& qvalues : *qs)
+                if (qvalues.IsUsed())
+                    qvalues.SetValues(*value++);
+        for (auto& law : _laws)
+            for (QValues* history : law->History())
+                history->SetValues(*value++);
+
+        _last_inputs.clear();
+        _ips_checked = false;
+    }
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Snapshot
+    {
+        Clock::time_point time;
+        PerfCounters::Values counters;
+    };
+
+    //! @brief Opens the hardware counters for the calling thread and its
+    //! team, again if the threads changed, e.g. by `SetNumThreads` or if
+    //! another (Python) thread calls `Evaluate`.
+    void OpenPerfCounters()
+    {
+        if (_record_stats and PerfCounters::Enabled() and not(_perf and _perf->Counts(_num_threads)))
+            _perf.reset(new PerfCounters(_num_threads));
+    }
+
+    Snapshot Now() const
+    {
+        Snapshot now{Clock::now(), {}};
+        if (_perf)
+            now.counters = _perf->Read();
+        return now;
+    }
+
+    //! @brief adds the time and the counts since `start`
+    void AddSince(const Snapshot& start, double& seconds, PerfCounters::Values& counters) const
+    {
+        const Snapshot now = Now();
+        seconds += std::chrono::duration<double>(now.time - start.time).count();
+        for (int e = 0; e < PerfCounters::num_events; ++e)
+            counters[e] += now.counters[e] - start.counters[e];
+    }
+
+    void RecordEvaluate(int iLaw, const Snapshot& start)
+    {
+        LawStats& stats = _stats[iLaw];
+        AddSince(start, stats.evaluate_seconds, stats.evaluate_counters);
+        stats.evaluate_calls += 1;
+        const std::vector<int>& ips = _ips[iLaw];
+        if (_tolerance < 0. or dynamic_cast<BlockLaw*>(_laws[iLaw].get()))
+            stats.evaluated_ips += ips.size();
+        else
+            stats.evaluated_ips += std::count_if(ips.begin(), ips.end(), [&](int ip) { return _dirty[ip]; });
+    }
+
+    void RecordUpdate(int iLaw, const Snapshot& start)
+    {
+        LawStats& stats = _stats[iLaw];
+        const std::vector<int>& ips = _ips[iLaw];
+        AddSince(start, stats.update_seconds, stats.update_counters);
+        stats.update_calls += 1;
+        stats.updated_ips += ips.size();
+        stats.max_evaluate_calls_per_step = std::max(stats.max_evaluate_calls_per_step, _evaluate_calls_in_step);
+
+        CopyHistory(*_laws[iLaw], _history_after);
+        if (_history_after.empty())
+            return;
+        for (int ip : ips)
+        {
+            bool changed = false;
+            for (unsigned h = 0; h < _history_after.size() and not changed; ++h)
+            {
+                const int size = _history_after[h].size() / _n;
+                changed = _history_after[h].segment(size * ip, size) != _history_before[h].segment(size * ip, size);
+            }
+            if (changed)
+                stats.loading_ips += 1;
+            else
+                stats.unloading_ips += 1;
+        }
+    }
+
+    void CopyHistory(LawInterface& law, std::vector<Eigen::VectorXd>& copy) const
+    {
+        const std::vector<QValues*> history = law.History();
+        copy.resize(history.size());
+        for (unsigned h = 0; h < history.size(); ++h)
+        {
+            copy[h].resize(static_cast<Eigen::Index>(_n) * history[h]->_rows * history[h]->_cols);
+            history[h]->CopyTo(copy[h]);
+        }
+    }
+
+    void SetInputs(const Eigen::Ref<const Eigen::VectorXd>& all_strains,
+                   const Eigen::Ref<const Eigen::VectorXd>& all_neeq)
+    {
+        if (_inputs[EPS].IsUsed())
+            _inputs[EPS].SetValues(all_strains);
+        if (_inputs[E].IsUsed())
+            _inputs[E].SetValues(all_neeq);
+    }
+
+    void MarkDirtyIPs()
+    {
+        _dirty.assign(_n, true);
+        _dirty_fraction = 1.;
+        if (_tolerance < 0.)
+            return;
+
+        if (_last_inputs.empty())
+        {
+            _required = RequiredInputs();
+            _last_inputs.resize(Q::LAST);
+            for (Q q : _required)
+                _last_inputs[q] = _inputs[q].Values();
+            return;
+        }
+
+        // Written as "not all within", so a NaN in the inputs marks its IP
+        // dirty. "max > tolerance" is false for NaN.
+        _dirty.assign(_n, false);
+        for (Q q : _required)
+        {
+            const int size = _inputs[q].Size();
+            const Eigen::VectorXd& last = _last_inputs[q];
+            for (int ip = 0; ip < _n; ++ip)
+                if (not _dirty[ip])
+                    _dirty[ip] = not((Eigen::Map<const Eigen::VectorXd>(_inputs[q].Pointer<double>(ip), size) -
+                                      last.segment(size * ip, size))
+                                             .array()
+                                             .abs() <= _tolerance)
+                                            .all();
+        }
+
+        // Compare against the inputs of the last _evaluation_ of each IP such
+        // that many small changes below the tolerance cannot add up unnoticed.
+        int num_dirty = 0;
+        for (int ip = 0; ip < _n; ++ip)
+        {
+            if (not _dirty[ip])
+                continue;
+            ++num_dirty;
+            for (Q q : _required)
+            {
+                const int size = _inputs[q].Size();
+                _last_inputs[q].segment(size * ip, size) =
+                        Eigen::Map<const Eigen::VectorXd>(_inputs[q].Pointer<double>(ip), size);
+            }
+        }
+        _dirty_fraction = _n == 0 ? 0. : static_cast<double>(num_dirty) / _n;
+    }
+
+    //! @brief calls `f(ip)` for all IPs of law `iLaw`, distributed over the
+    //! threads. A parallel region allocates (libgomp) even for a single
+    //! thread, so that case runs serially.
+    template <typename TFunction>
+    void ForEachIP(int iLaw, TFunction f)
+    {
+        const std::vector<int>& ips = _ips[iLaw];
+        const int num_ips = ips.size();
+        if (_num_threads == 1)
+        {
+            TraceScope chunk("chunk", iLaw);
+            for (int k = 0; k < num_ips; ++k)
+                f(ips[k]);
+            return;
+        }
+#ifdef _OPENMP
+#pragma omp parallel num_threads(_num_threads)
+#endif
+        {
+            TraceScope chunk("chunk", iLaw);
+#ifdef _OPENMP
+#pragma omp for schedule(static) nowait
+#endif
+            for (int k = 0; k < num_ips; ++k)
+                f(ips[k]);
+        }
+    }
+
+    std::vector<Precision> _precision;
+    //! @brief `LawInterface::OutputsVersion` of each law in `DefineOutputs`
+    std::vector<int> _outputs_versions;
+    AlignedBuffer _arena;
+    ArenaLayout _arena_layout = BLOCKED;
+    int _num_threads = 1;
+    double _tolerance = -1.;
+    double _dirty_fraction = 1.;
+    bool _compute_tangents = true;
+    bool _tangents_current = true;
+    std::vector<bool> _dirty;
+    std::vector<Eigen::VectorXd> _last_inputs;
+    std::vector<Q> _required;
+    bool _ips_checked = false;
+    bool _record_stats = false;
+    std::unique_ptr<PerfCounters> _perf;
+    long _evaluate_calls_in_step = 0;
+    std::vector<LawStats> _stats;
+    std::vector<Eigen::VectorXd> _history_before;
+    std::vector<Eigen::VectorXd> _history_after;
 };
 
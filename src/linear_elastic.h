@@ -80,6 +80,19 @@ public:
         return {_C * strain, _C};
     }
 
+    void EvaluateTo(const Eigen::Ref<const Eigen::VectorXd>& strain, Eigen::Ref<Eigen::VectorXd> stress,
+                    Eigen::Ref<Eigen::MatrixXd> tangent, int i) override
+    {
+        stress.noalias() = _C * strain;
+        if (tangent.size() != 0)
+            tangent = _C;
+    }
+
+    bool SymmetricTangent() const override
+    {
+        return true;
+    }
+
 private:
     Eigen::MatrixXd _C;
 };
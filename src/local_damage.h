@@ -10,6 +10,15 @@ struct DamageLawInterface
 struct StrainNormInterface
 {
     virtual std::pair<double, Eigen::VectorXd> Evaluate(Eigen::VectorXd strain) const = 0;
+
+    //! @brief returns the norm and writes its derivative to `deeq`, without
+    //! allocating in the built-in norms
+    virtual double EvaluateTo(const Eigen::Ref<const Eigen::VectorXd>& strain, Eigen::Ref<Eigen::VectorXd> deeq) const
+    {
+        const auto result = Evaluate(strain);
+        deeq = result.second;
+        return result.first;
+    }
 };
 
 class DamageLawExponential : public DamageLawInterface
@@ -31,6 +40,16 @@ public:
         return {omega, domega};
     }
 
+    //! @brief omega only, for any scalar type, e.g. a `Dual`
+    template <typename T>
+    T Omega(const T& k) const
+    {
+        using std::exp;
+        if (k <= _k0)
+            return T(0.);
+        return 1. - _k0 / k * (1. - _a + _a * exp(_b * (_k0 - k)));
+    }
+
 private:
     const double _k0;
     const double _a;
@@ -115,7 +134,14 @@ public:
     {
     }
 
-    std::pair<double, Eigen::VectorXd> Evaluate(Eigen::VectorXd strain) const
+    std::pair<double, Eigen::VectorXd> Evaluate(Eigen::VectorXd strain) const override
+    {
+        std::pair<double, Eigen::VectorXd> result(0., Eigen::VectorXd(strain.rows()));
+        result.first = EvaluateTo(strain, result.second);
+        return result;
+    }
+
+    double EvaluateTo(const Eigen::Ref<const Eigen::VectorXd>& strain, Eigen::Ref<Eigen::VectorXd> deeq) const override
     {
         // transformation to 3D and invariants
         const V<FULL> strain3D = _T3D * strain;
@@ -131,8 +157,22 @@ public:
         const double deeq_dJ2 = _K2 / (2 * A);
         //
         //// derivative in 3D and transformation back
-        V<FULL> deeq = deeq_dI1 * dI1 + deeq_dJ2 * dJ2;
-        return {eeq, _T3D.transpose() * deeq};
+        const V<FULL> deeq3D = deeq_dI1 * dI1 + deeq_dJ2 * dJ2;
+        deeq.noalias() = _T3D.transpose() * deeq3D;
+        return eeq;
+    }
+
+    //! @brief the norm only, for any scalar type, e.g. a `Dual`
+    template <typename T>
+    T Norm(const VectorQT<T>& strain) const
+    {
+        using std::sqrt;
+        const VectorQT<T> v = Multiply(_T3D, strain);
+        const T I1 = v[0] + v[1] + v[2];
+        const T d01 = v[0] - v[1], d12 = v[1] - v[2], d20 = v[2] - v[0];
+        const T J2 = (d01 * d01 + d12 * d12 + d20 * d20) / 6. + 0.25 * (v[3] * v[3] + v[4] * v[4] + v[5] * v[5]);
+        const T A = sqrt(_K1 * _K1 * I1 * I1 + _K2 * J2) + 1.e-14;
+        return _K1 * I1 + A;
     }
 
 private:
@@ -143,6 +183,91 @@ private:
     const Eigen::Matrix<double, 6, Eigen::Dynamic> _T3D;
 };
 
+//! @brief Tangents of the damage laws. CONSISTENT is the exact derivative
+//! of the stresses, which is non-symmetric and may be indefinite in
+//! softening. SECANT is the symmetric positive definite (1 - omega) C that
+//! ignores the evolution of kappa within the iteration. For `GradientDamage`,
+//! the couplings DSIGMA_DE and DEEQ vanish as well, so the system becomes
+//! block diagonal and symmetric, e.g. for CG with AMG. Newton then only
+//! converges linearly.
+//!
+//! A `LocalDamage` in SECANT mode stores its tangent packed, see
+//! `MechanicsLaw::SymmetricTangent`. Switching the mode changes its
+//! `OutputsVersion`, so an `IpLoop` lays out its arena again.
+enum TangentMode
+{
+    CONSISTENT,
+    SECANT
+};
+
+//! @brief Implicit-explicit (IMPL-EX) integration of the damage history
+//! kappa, see Titscher et al. 2019, "Implicit-explicit integration of
+//! gradient-enhanced damage models". Within a step, kappa is linearly
+//! extrapolated from the two previous committed states
+//!
+//!     kappa = kappa_n + r (kappa_n - kappa_n-1),   r = dt_n+1 / dt_n,
+//!
+//! so omega does not depend on the current strains. The tangent is the
+//! symmetric secant (1 - omega) C and constant within the step. For
+//! `GradientDamage`, DSIGMA_DE and DEEQ vanish as well, so the whole coupled
+//! Jacobian is symmetric, block diagonal and constant within the step, and a
+//! single factorization per step suffices: the displacements converge in the
+//! first iteration, the nonlocal equivalent strains in the second. `Update`
+//! still commits the implicit kappa of the converged strains. The step size
+//! is not checked, so large steps are less accurate, not unstable.
+class ImplEx
+{
+public:
+    //! @brief changes the number of history values, so it must happen
+    //! before the law is resized, e.g. before `IpLoop::AddLaw`
+    void Enable(bool enable, const QValues& kappa)
+    {
+        if (enable != _enabled and kappa.Bytes() != 0)
+            throw std::runtime_error("IMPL-EX must be selected before the law is resized.");
+        _enabled = enable;
+    }
+
+    bool Enabled() const
+    {
+        return _enabled;
+    }
+
+    //! @brief ratio r of the current and the previous time step
+    void SetStepRatio(double ratio)
+    {
+        _step_ratio = ratio;
+    }
+
+    double Extrapolate(const QValues& kappa, int i) const
+    {
+        const double kappa_n = kappa.GetScalar(i);
+        return kappa_n + _step_ratio * (kappa_n - _kappa_old.GetScalar(i));
+    }
+
+    //! @brief stores kappa_n before it is overwritten by kappa_n+1
+    void Commit(double kappa_n, int i)
+    {
+        if (_enabled)
+            _kappa_old.Set(kappa_n, i);
+    }
+
+    void Resize(int n)
+    {
+        if (_enabled)
+            _kappa_old.Resize(n);
+    }
+
+    void AddHistory(std::vector<QValues*>& history)
+    {
+        if (_enabled)
+            history.push_back(&_kappa_old);
+    }
+
+private:
+    bool _enabled = false;
+    double _step_ratio = 1.;
+    QValues _kappa_old = QValues(1);
+};
 
 class LocalDamage : public MechanicsLaw
 {
@@ -160,18 +285,88 @@ public:
     void Resize(int n) override
     {
         _kappa.Resize(n);
+        _impl_ex.Resize(n);
+    }
+
+    bool SymmetricTangent() const override
+    {
+        return _impl_ex.Enabled() or _tangent_mode == SECANT;
+    }
+
+    std::vector<QValues*> History() override
+    {
+        std::vector<QValues*> history = {&_kappa};
+        _impl_ex.AddHistory(history);
+        return history;
+    }
+
+    //! @brief selects the IMPL-EX integration of kappa, see `ImplEx`
+    void SetImplEx(bool impl_ex)
+    {
+        _impl_ex.Enable(impl_ex, _kappa);
+    }
+
+    void SetStepRatio(double ratio)
+    {
+        _impl_ex.SetStepRatio(ratio);
+    }
+
+    //! @brief may change between any two evaluations, see `TangentMode`
+    void SetTangentMode(TangentMode mode)
+    {
+        const bool symmetric = SymmetricTangent();
+        _tangent_mode = mode;
+        if (SymmetricTangent() != symmetric)
+            ++_outputs_version;
+    }
+
+    int OutputsVersion() const override
+    {
+        return _outputs_version;
     }
 
     std::pair<Eigen::VectorXd, Eigen::MatrixXd> Evaluate(const Eigen::VectorXd& strain, int i) override
     {
-        double kappa, dkappa, omega, domega, eeq;
-        Eigen::VectorXd deeq;
+        std::pair<Eigen::VectorXd, Eigen::MatrixXd> result(Eigen::VectorXd(_C.rows()),
+                                                           Eigen::MatrixXd(_C.rows(), _C.cols()));
+        EvaluateTo(strain, result.first, result.second, i);
+        return result;
+    }
+
+    Eigen::VectorXd EvaluateStress(const Eigen::VectorXd& strain, int i) override
+    {
+        Eigen::VectorXd stress(_C.rows());
+        Eigen::MatrixXd no_tangent(0, 0);
+        EvaluateTo(strain, stress, no_tangent, i);
+        return stress;
+    }
+
+    void EvaluateTo(const Eigen::Ref<const Eigen::VectorXd>& strain, Eigen::Ref<Eigen::VectorXd> stress,
+                    Eigen::Ref<Eigen::MatrixXd> tangent, int i) override
+    {
+        double kappa, dkappa, omega, domega;
+        VectorQ deeq(strain.rows());
 
-        std::tie(eeq, deeq) = _strain_norm->Evaluate(strain);
-        std::tie(kappa, dkappa) = EvaluateKappa(eeq, _kappa.GetScalar(i));
+        if (_impl_ex.Enabled())
+            std::tie(kappa, dkappa) = std::make_pair(_impl_ex.Extrapolate(_kappa, i), 0.);
+        else
+            std::tie(kappa, dkappa) = EvaluateKappa(_strain_norm->EvaluateTo(strain, deeq), _kappa.GetScalar(i));
+        if (_tangent_mode == SECANT)
+            dkappa = 0.;
         std::tie(omega, domega) = _omega->Evaluate(kappa);
 
-        return {(1. - omega) * _C * strain, (1. - omega) * _C - _C * strain * domega * dkappa * deeq.transpose()};
+        // the undamaged stress first, it is needed in the tangent
+        stress.noalias() = _C * strain;
+        if (tangent.size() != 0 and dkappa == 0.)
+            tangent = (1. - omega) * _C;
+        else if (tangent.size() != 0)
+        {
+            // a scaled factor of the outer product would be a heap temporary
+            deeq *= domega * dkappa;
+            tangent = (1. - omega) * _C;
+            tangent.noalias() -= stress * deeq.transpose();
+        }
+        stress *= 1. - omega;
     }
 
     std::pair<double, double> EvaluateKappa(double eeq, double kappa) const
@@ -182,16 +377,18 @@ public:
             return {kappa, 0};
     }
 
-    virtual void Update(const Eigen::VectorXd& strain, int i) override
+    virtual void Update(const Eigen::Ref<const Eigen::VectorXd>& strain, int i) override
     {
-        const double eeq = _strain_norm->Evaluate(strain).first;
+        VectorQ deeq(strain.rows());
+        const double eeq = _strain_norm->EvaluateTo(strain, deeq);
         const double kappa = EvaluateKappa(eeq, _kappa.GetScalar(i)).first;
+        _impl_ex.Commit(_kappa.GetScalar(i), i);
         _kappa.Set(kappa, i);
     }
 
     Eigen::VectorXd Kappa() const
     {
-        return _kappa.data;
+        return _kappa.Values();
     }
 
 
@@ -200,6 +397,9 @@ private:
     std::shared_ptr<DamageLawInterface> _omega;
     std::shared_ptr<StrainNormInterface> _strain_norm;
     QValues _kappa;
+    ImplEx _impl_ex;
+    TangentMode _tangent_mode = CONSISTENT;
+    int _outputs_version = 0;
 };
 
 class GradientDamage : public LawInterface
@@ -221,7 +421,7 @@ public:
         out[DEEQ] = QValues(q);
         out[SIGMA] = QValues(q);
         out[DSIGMA_DE] = QValues(q);
-        out[DSIGMA_DEPS] = QValues(q, q);
+        out[DSIGMA_DEPS] = QValues(q, q, SYMMETRIC);
     }
 
     void DefineInputs(std::vector<QValues>& input) const override
@@ -234,23 +434,78 @@ public:
     void Resize(int n) override
     {
         _kappa.Resize(n);
+        _impl_ex.Resize(n);
+    }
+
+    std::vector<QValues*> History() override
+    {
+        std::vector<QValues*> history = {&_kappa};
+        _impl_ex.AddHistory(history);
+        return history;
+    }
+
+    //! @brief selects the IMPL-EX integration of kappa, see `ImplEx`. Then,
+    //! the stresses do not depend on the nonlocal equivalent strains within
+    //! a step and DSIGMA_DE vanishes.
+    void SetImplEx(bool impl_ex)
+    {
+        _impl_ex.Enable(impl_ex, _kappa);
+    }
+
+    void SetStepRatio(double ratio)
+    {
+        _impl_ex.SetStepRatio(ratio);
+    }
+
+    //! @brief may change between any two evaluations, see `TangentMode`
+    void SetTangentMode(TangentMode mode)
+    {
+        _tangent_mode = mode;
     }
 
     void Evaluate(const std::vector<QValues>& input, std::vector<QValues>& out, int i) override
     {
-        double kappa, dkappa, omega, domega, eeq;
-        Eigen::VectorXd deeq;
-        auto strain = input[EPS].Get(i);
+        double kappa, dkappa, omega, domega;
+        const int q = _C.rows();
+        VectorQ strain(q), deeq(q), stress(q), dsigma_de(q);
+        MatrixQ tangent(q, q);
+        input[EPS].GetTo(i, strain);
 
-        std::tie(kappa, dkappa) = EvaluateKappa(input[E].GetScalar(i), _kappa.GetScalar(i));
+        if (_impl_ex.Enabled())
+            std::tie(kappa, dkappa) = std::make_pair(_impl_ex.Extrapolate(_kappa, i), 0.);
+        else
+            std::tie(kappa, dkappa) = EvaluateKappa(input[E].GetScalar(i), _kappa.GetScalar(i));
+        if (_tangent_mode == SECANT)
+            dkappa = 0.;
         std::tie(omega, domega) = _omega->Evaluate(kappa);
-        std::tie(eeq, deeq) = _strain_norm->Evaluate(strain);
+        const double eeq = _strain_norm->EvaluateTo(strain, deeq);
+        if (_tangent_mode == SECANT or _impl_ex.Enabled())
+            deeq.setZero();
 
         out[EEQ].Set(eeq, i);
-        out[SIGMA].Set((1. - omega) * _C * strain, i);
         out[DEEQ].Set(deeq, i);
-        out[DSIGMA_DE].Set(-_C * strain * domega * dkappa, i);
-        out[DSIGMA_DEPS].Set((1. - omega) * _C, i);
+
+        // the undamaged stress first, it is needed in both outputs
+        stress.noalias() = _C * strain;
+        dsigma_de = -(domega * dkappa) * stress;
+        out[DSIGMA_DE].Set(dsigma_de, i);
+        stress *= 1. - omega;
+        out[SIGMA].Set(stress, i);
+        tangent = (1. - omega) * _C;
+        out[DSIGMA_DEPS].Set(tangent, i);
+    }
+
+    void EvaluateWithoutTangents(const std::vector<QValues>& input, std::vector<QValues>& out, int i) override
+    {
+        const int q = _C.rows();
+        VectorQ strain(q), deeq(q), stress(q);
+        input[EPS].GetTo(i, strain);
+        const double kappa = _impl_ex.Enabled() ? _impl_ex.Extrapolate(_kappa, i)
+                                                : EvaluateKappa(input[E].GetScalar(i), _kappa.GetScalar(i)).first;
+
+        out[EEQ].Set(_strain_norm->EvaluateTo(strain, deeq), i);
+        stress.noalias() = (1. - _omega->Evaluate(kappa).first) * _C * strain;
+        out[SIGMA].Set(stress, i);
     }
 
     std::pair<double, double> EvaluateKappa(double eeq, double kappa) const
@@ -263,12 +518,13 @@ public:
 
     void Update(const std::vector<QValues>& input, int i) override
     {
+        _impl_ex.Commit(_kappa.GetScalar(i), i);
         _kappa.Set(EvaluateKappa(input[E].GetScalar(i), _kappa.GetScalar(i)).first, i);
     }
 
     Eigen::VectorXd Kappa() const
     {
-        return _kappa.data;
+        return _kappa.Values();
     }
 
 
@@ -279,5 +535,7 @@ private:
 
     // history values
     QValues _kappa;
+    ImplEx _impl_ex;
+    TangentMode _tangent_mode = CONSISTENT;
 };
 
@@ -0,0 +1,147 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef CONSTITUTIVE_PERF_COUNTERS
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#endif
+
+//! @brief Hardware counters of the calling thread and of its OpenMP team of
+//! `num_threads`, via the Linux `perf_event_open`. Only compiled with
+//! CONSTITUTIVE_PERF_COUNTERS, otherwise `Enabled()` is false and nothing is
+//! measured.
+//!
+//! The counters are opened per thread inside a parallel region, so they
+//! also count an OpenMP pool that already exists. Inherited counters would
+//! only count threads created afterwards. OpenMP runtimes reuse the threads
+//! of a team for the following regions of the same size, e.g. those of
+//! `IpLoop::ForEachIP`. A team of another size or another calling thread is
+//! not counted, see `Counts`.
+//!
+//! There is no portable FLOP event. A CPU specific one may be given as raw
+//! event code in the environment variable CONSTITUTIVE_PERF_RAW, e.g. 0x01c7
+//! for FP_ARITH_INST_RETIRED.SCALAR_DOUBLE on recent Intel CPUs.
+class PerfCounters
+{
+public:
+    static constexpr int num_events = 6;
+    using Values = std::array<double, num_events>;
+
+    static const std::array<std::string, num_events>& Names()
+    {
+        static const std::array<std::string, num_events> names = {
+                {"cycles", "instructions", "cache_references", "cache_misses", "branch_misses", "raw"}};
+        return names;
+    }
+
+    static constexpr bool Enabled()
+    {
+#ifdef CONSTITUTIVE_PERF_COUNTERS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    explicit PerfCounters(int num_threads = 1)
+        : _fds(num_threads)
+        , _thread(std::this_thread::get_id())
+    {
+        for (auto& fds : _fds)
+            fds.fill(-1);
+#ifdef CONSTITUTIVE_PERF_COUNTERS
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads)
+        OpenThread(_fds[omp_get_thread_num()]);
+#else
+        OpenThread(_fds[0]);
+#endif
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters()
+    {
+#ifdef CONSTITUTIVE_PERF_COUNTERS
+        for (const auto& fds : _fds)
+            for (int fd : fds)
+                if (fd >= 0)
+                    close(fd);
+#endif
+    }
+
+    //! @brief true if the counters cover the calling thread and its team of
+    //! `num_threads`, otherwise they have to be opened again
+    bool Counts(int num_threads) const
+    {
+        return _thread == std::this_thread::get_id() and static_cast<int>(_fds.size()) == num_threads;
+    }
+
+    //! @brief current counts summed over the threads, scaled if the kernel
+    //! multiplexed the counters, NaN for counters that are not available
+    Values Read() const
+    {
+        Values values;
+        values.fill(std::numeric_limits<double>::quiet_NaN());
+#ifdef CONSTITUTIVE_PERF_COUNTERS
+        for (const auto& fds : _fds)
+            for (int e = 0; e < num_events; ++e)
+            {
+                // value, time enabled, time running
+                std::uint64_t data[3];
+                if (fds[e] < 0 or read(fds[e], data, sizeof(data)) != sizeof(data))
+                    continue;
+                const double value = data[2] == 0 ? 0. : data[0] * (static_cast<double>(data[1]) / data[2]);
+                values[e] = std::isnan(values[e]) ? value : values[e] + value;
+            }
+#endif
+        return values;
+    }
+
+private:
+#ifdef CONSTITUTIVE_PERF_COUNTERS
+    //! @brief opens all counters of the calling thread
+    static void OpenThread(std::array<int, num_events>& fds)
+    {
+        const std::array<std::pair<std::uint32_t, std::uint64_t>, num_events - 1> events = {
+                {{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                 {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                 {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+                 {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                 {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}}};
+        for (int e = 0; e < num_events - 1; ++e)
+            fds[e] = Open(events[e].first, events[e].second);
+        if (const char* raw = std::getenv("CONSTITUTIVE_PERF_RAW"))
+            fds[num_events - 1] = Open(PERF_TYPE_RAW, std::strtoull(raw, nullptr, 0));
+    }
+
+    static int Open(std::uint32_t type, std::uint64_t config)
+    {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+
+    //! @brief the counters per thread of the team
+    std::vector<std::array<int, num_events>> _fds;
+    std::thread::id _thread;
+};
@@ -1,5 +1,9 @@
 #pragma once
 #include "interfaces.h"
+#include "linear_elastic.h"
+#include <eigen3/Eigen/LU>
+#include <limits>
+#include <stdexcept>
 #include <tuple>
 
 class NormVM
@@ -28,7 +32,9 @@ public:
         }
         else if (_q == 6)
         {
-            // kein bock.
+            _P.topLeftCorner<3, 3>() << 2, -1, -1, -1, 2, -1, -1, -1, 2;
+            _P.bottomRightCorner<3, 3>() = f * Eigen::Matrix3d::Identity();
+            _P *= 1. / 3.;
         }
     }
 
@@ -49,7 +55,7 @@ public:
             double se = std::sqrt(1.5 * ss.transpose() * _P * ss);
             if (se == 0)
             {
-                return {se, Eigen::MatrixXd::Zero(_q, _q)};
+                return {se, Eigen::VectorXd::Zero(_q)};
             }
             else
             {
@@ -83,4 +89,277 @@ public:
     {
     return {_p, _dp_dsig, _dp_dk};
     }
-};
\ No newline at end of file
+};
+
+//! @brief Von Mises plasticity with linear isotropic hardening
+//!
+//!     f = se(sigma) - (sig0 + H kappa),   kappa = equivalent plastic strain
+//!
+//! integrated by a backward Euler return mapping. Its local Newton method
+//! solves for the stress, kappa and the plastic multiplier as in
+//! test_plasticity.py and provides the consistent tangent.
+//!
+//! Large strain increments may keep the local Newton method from
+//! converging. With `SetMaxSubsteps`, only the IPs where it fails divide
+//! their increment (from the last committed strain) into 2, 4, ... substeps
+//! up to the given maximum. The tangent is then the consistent tangent of
+//! the last substep. A failing evaluation returns NaN, so the global solver
+//! rejects the step. `Substeps` counts the substeps of each IP in the last
+//! `Update`, zero if it failed even with the maximum number of substeps and
+//! the IP kept its history. Evaluations, e.g. by `CheckTangents`, do not
+//! change the counts.
+//!
+//! `NormVM` only sees the stress components of the constraint. With
+//! PLANE_STRAIN or UNIAXIAL_STRAIN, it would miss the out-of-plane stresses,
+//! so these constraints are rejected.
+class VonMisesPlasticity : public LawInterface
+{
+public:
+    VonMisesPlasticity(double E, double nu, Constraint c, double sig0, double H)
+        : _C(C(E, nu, Checked(c)))
+        , _P(NormVM(c)._P)
+        , _sig0(sig0)
+        , _H(H)
+        , _strain(Dim::Q(c))
+        , _plastic_strain(Dim::Q(c))
+        , _kappa(1)
+    {
+        if (sig0 <= 0.)
+            throw std::invalid_argument("VonMisesPlasticity requires a positive yield stress sig0.");
+    }
+
+    void DefineOutputs(std::vector<QValues>& out) const override
+    {
+        const int q = _C.rows();
+        out[SIGMA] = QValues(q);
+        out[DSIGMA_DEPS] = QValues(q, q);
+    }
+
+    void DefineInputs(std::vector<QValues>& input) const override
+    {
+        input[EPS] = QValues(_C.rows());
+    }
+
+    //! @brief `tolerance` of the local Newton method, unit free: its stress
+    //! residuals are relative to the yield stress at the start of the step
+    void SetReturnMapping(double tolerance, int max_iterations)
+    {
+        _tolerance = tolerance;
+        _max_iterations = max_iterations;
+    }
+
+    void SetMaxSubsteps(int max_substeps)
+    {
+        if (max_substeps < 1)
+            throw std::runtime_error("At least one substep is required.");
+        _max_substeps = max_substeps;
+    }
+
+    void Evaluate(const std::vector<QValues>& input, std::vector<QValues>& out, int i) override
+    {
+        const int q = _C.rows();
+        VectorQ strain(q), stress(q), plastic_strain(q);
+        MatrixQ tangent(q, q);
+        double kappa;
+        input[EPS].GetTo(i, strain);
+        Integrate(strain, i, stress, &tangent, plastic_strain, kappa);
+        out[SIGMA].Set(stress, i);
+        out[DSIGMA_DEPS].Set(tangent, i);
+    }
+
+    void Update(const std::vector<QValues>& input, int i) override
+    {
+        const int q = _C.rows();
+        VectorQ strain(q), stress(q), plastic_strain(q);
+        double kappa;
+        input[EPS].GetTo(i, strain);
+        _substeps[i] = Integrate(strain, i, stress, nullptr, plastic_strain, kappa);
+        if (_substeps[i] == 0)
+            return;
+        _strain.Set(strain, i);
+        _plastic_strain.Set(plastic_strain, i);
+        _kappa.Set(kappa, i);
+    }
+
+    void Resize(int n) override
+    {
+        _strain.Resize(n);
+        _plastic_strain.Resize(n);
+        _kappa.Resize(n);
+        _substeps.assign(n, 1);
+    }
+
+    std::vector<QValues*> History() override
+    {
+        return {&_strain, &_plastic_strain, &_kappa};
+    }
+
+    Eigen::VectorXd Kappa() const
+    {
+        return _kappa.Values();
+    }
+
+    Eigen::VectorXi Substeps() const
+    {
+        return Eigen::Map<const Eigen::VectorXi>(_substeps.data(), _substeps.size());
+    }
+
+    std::size_t OtherBytes() const override
+    {
+        return _substeps.size() * sizeof(int);
+    }
+
+private:
+    static Constraint Checked(Constraint c)
+    {
+        if (c == PLANE_STRAIN or c == UNIAXIAL_STRAIN)
+            throw std::invalid_argument("VonMisesPlasticity requires a stress state without out-of-plane stresses, "
+                                        "i.e. UNIAXIAL_STRESS, PLANE_STRESS or FULL.");
+        return c;
+    }
+
+    //! @brief integrates from the last committed state to `strain` and
+    //! returns the number of substeps, zero if the return mapping failed
+    int Integrate(const VectorQ& strain, int i, VectorQ& stress, MatrixQ* tangent, VectorQ& plastic_strain,
+                  double& kappa) const
+    {
+        const int q = _C.rows();
+        VectorQ strain_n(q), plastic_strain_n(q), strain_s(q);
+        _strain.GetTo(i, strain_n);
+        _plastic_strain.GetTo(i, plastic_strain_n);
+        const double kappa_n = _kappa.GetScalar(i);
+
+        for (int substeps = 1; substeps <= _max_substeps; substeps *= 2)
+        {
+            plastic_strain = plastic_strain_n;
+            kappa = kappa_n;
+            bool converged = true;
+            for (int s = 1; s <= substeps and converged; ++s)
+            {
+                strain_s = strain_n + (strain - strain_n) * (static_cast<double>(s) / substeps);
+                converged = ReturnMapping(strain_s, stress, tangent, plastic_strain, kappa);
+            }
+            if (converged)
+                return substeps;
+        }
+        stress.setConstant(std::numeric_limits<double>::quiet_NaN());
+        if (tangent)
+            tangent->setConstant(std::numeric_limits<double>::quiet_NaN());
+        return 0;
+    }
+
+    //! @brief von Mises stress `se`, its derivative `m` and, if q > 1, the
+    //! second derivative `dm`
+    void Norm(const VectorQ& stress, double& se, VectorQ& m, MatrixQ& dm) const
+    {
+        if (stress.rows() == 1)
+        {
+            se = std::abs(stress[0]);
+            m[0] = stress[0] < 0. ? -1. : 1.;
+            dm.setZero();
+            return;
+        }
+        m.noalias() = _P * stress;
+        se = std::sqrt(1.5 * stress.dot(m));
+        if (se == 0.)
+        {
+            m.setZero();
+            dm.setZero();
+            return;
+        }
+        // dm = 1.5 / se (P - P stress m^T / se) with P stress = m here
+        dm = _P;
+        dm.noalias() -= (1.5 / (se * se)) * m * m.transpose();
+        dm *= 1.5 / se;
+        m *= 1.5 / se;
+    }
+
+    //! @brief one backward Euler step from `plastic_strain`, `kappa` to the
+    //! total `strain`, returns false if the local Newton method fails
+    bool ReturnMapping(const VectorQ& strain, VectorQ& stress, MatrixQ* tangent, VectorQ& plastic_strain,
+                       double& kappa) const
+    {
+        const int q = _C.rows();
+        using VectorN = Eigen::Matrix<double, Eigen::Dynamic, 1, Eigen::ColMajor, 8, 1>;
+        using MatrixN = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor, 8, 8>;
+
+        stress.noalias() = _C * (strain - plastic_strain);
+        double se;
+        VectorQ m(q);
+        MatrixQ dm(q, q);
+        Norm(stress, se, m, dm);
+        double f = se - (_sig0 + _H * kappa);
+        if (f <= 0.)
+        {
+            if (tangent)
+                *tangent = _C;
+            return true;
+        }
+
+        // unknowns x = [stress, kappa, dlambda] with the residuals
+        //   r = [stress - trial + dlambda C m, kappa - kappa_n - dlambda, f]
+        const VectorQ trial = stress;
+        const double kappa_n = kappa;
+        const double scale = 1. / (_sig0 + _H * kappa_n);
+        double dlambda = 0.;
+        VectorN r(q + 2);
+        MatrixN J(q + 2, q + 2);
+        for (int iteration = 0;; ++iteration)
+        {
+            r.head(q) = stress - trial;
+            r.head(q).noalias() += dlambda * _C * m;
+            r[q] = kappa - kappa_n - dlambda;
+            r[q + 1] = f;
+
+            J.setZero();
+            J.topLeftCorner(q, q) = MatrixQ::Identity(q, q);
+            J.topLeftCorner(q, q).noalias() += dlambda * _C * dm;
+            J.col(q + 1).head(q).noalias() = _C * m;
+            J(q, q) = 1.;
+            J(q, q + 1) = -1.;
+            J.row(q + 1).head(q) = m.transpose();
+            J(q + 1, q) = -_H;
+
+            // stresses and f relative to the yield stress, kappa is a strain
+            const double error =
+                    std::sqrt(scale * scale * (r.head(q).squaredNorm() + r[q + 1] * r[q + 1]) + r[q] * r[q]);
+            if (not std::isfinite(error))
+                return false;
+            if (error <= _tolerance)
+                break;
+            if (iteration == _max_iterations)
+                return false;
+
+            const VectorN dx = J.partialPivLu().solve(r);
+            stress -= dx.head(q);
+            kappa -= dx[q];
+            dlambda -= dx[q + 1];
+            Norm(stress, se, m, dm);
+            f = se - (_sig0 + _H * kappa);
+        }
+
+        plastic_strain += dlambda * m;
+        if (tangent)
+        {
+            // consistent tangent: the stress block of J^-1 times C
+            const MatrixN inverse = J.partialPivLu().inverse();
+            tangent->noalias() = inverse.topLeftCorner(q, q) * _C;
+        }
+        return true;
+    }
+
+    MatrixQ _C;
+    MatrixQ _P;
+    double _sig0;
+    double _H;
+    double _tolerance = 1.e-9;
+    int _max_iterations = 20;
+    int _max_substeps = 1;
+
+    // history values: the committed total and plastic strains and kappa
+    QValues _strain;
+    QValues _plastic_strain;
+    QValues _kappa;
+
+    std::vector<int> _substeps;
+};
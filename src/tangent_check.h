@@ -0,0 +1,205 @@
+#pragma once
+#include "interfaces.h"
+#include <chrono>
+#include <limits>
+#include <random>
+
+//! @brief Relative errors of the tangents of an `IpLoop` per IP, see
+//! `TangentCheck`. The error of a tangent K is
+//!
+//!     |K - K_fd| / max(|K|, |K_fd|)     (Frobenius norms)
+//!
+//! with the central differences K_fd of the stresses, zero if both vanish
+//! and NaN if no law of the loop has that tangent.
+struct TangentErrors
+{
+    Eigen::VectorXd dsigma_deps;
+    Eigen::VectorXd dsigma_de;
+
+    //! @brief wall time of the evaluation of all IPs with tangents, of one
+    //! without tangents (mean) and of the whole check
+    double tangent_seconds = 0.;
+    double stress_seconds = 0.;
+    double seconds = 0.;
+};
+
+//! @brief Verifies DSIGMA_DEPS and DSIGMA_DE of all laws in an `IpLoop`
+//! against central differences of SIGMA, e.g. to validate approximate
+//! kernels or SINGLE precision outputs against the exact ones at scale.
+//!
+//! All IPs are perturbed at once, so each of the 2 (q + 1) stress
+//! evaluations is a parallel pass over the IPs of each law, as in the
+//! `IpLoop`. They work on copies of the inputs and outputs and do not
+//! update the laws, so the loop and its histories are unchanged afterwards.
+//!
+//! `delta` is the absolute perturbation of each strain component. Exact
+//! tangents may still show large errors at IPs whose perturbation crosses a
+//! kink of the law, e.g. from unloading to loading.
+class TangentCheck
+{
+public:
+    TangentCheck(IpLoop& loop, double delta = 1.e-6)
+        : _loop(loop)
+        , _delta(delta)
+    {
+    }
+
+    //! @brief checks the given states, the inputs of `IpLoop::Evaluate`
+    TangentErrors Check(const Eigen::Ref<const Eigen::VectorXd>& all_strains,
+                        const Eigen::Ref<const Eigen::VectorXd>& all_neeq)
+    {
+        const auto start = Clock::now();
+        _loop.FixIPs();
+        const int n = _loop._n;
+        for (unsigned iQ = 0; iQ < Q::LAST; ++iQ)
+        {
+            _inputs[iQ] = Like(_loop._inputs[iQ], n);
+            _outputs[iQ] = Like(_loop._outputs[iQ], n);
+        }
+        if (_inputs[EPS].IsUsed())
+            _inputs[EPS].SetValues(all_strains);
+        if (_inputs[E].IsUsed())
+            _inputs[E].SetValues(all_neeq);
+
+        TangentErrors errors;
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        errors.dsigma_deps = Eigen::VectorXd::Constant(n, nan);
+        errors.dsigma_de = Eigen::VectorXd::Constant(n, nan);
+        if (not _outputs[SIGMA].IsUsed())
+            throw std::runtime_error("The laws have no stresses to differentiate.");
+
+        errors.tangent_seconds = Evaluate(true);
+        const bool check_eps = _outputs[DSIGMA_DEPS].IsUsed() and _inputs[EPS].IsUsed();
+        const bool check_e = _outputs[DSIGMA_DE].IsUsed() and _inputs[E].IsUsed();
+        const Eigen::VectorXd dsigma_deps = check_eps ? _outputs[DSIGMA_DEPS].Values() : Eigen::VectorXd();
+        const Eigen::VectorXd dsigma_de = check_e ? _outputs[DSIGMA_DE].Values() : Eigen::VectorXd();
+
+        _stress_seconds = 0.;
+        _stress_passes = 0;
+        if (check_eps)
+            Compare(dsigma_deps, Differences(EPS), errors.dsigma_deps);
+        if (check_e)
+            Compare(dsigma_de, Differences(E), errors.dsigma_de);
+        errors.stress_seconds = _stress_passes == 0 ? 0. : _stress_seconds / _stress_passes;
+        errors.seconds = Seconds(start);
+        return errors;
+    }
+
+    //! @brief checks random states with strains in [-amplitude, amplitude]
+    //! and nonlocal equivalent strains in [0, amplitude]
+    TangentErrors CheckRandom(double amplitude, unsigned seed = 0)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<double> uniform(-amplitude, amplitude);
+        Eigen::VectorXd strains(static_cast<Eigen::Index>(_loop._n) * _loop._inputs[EPS]._rows);
+        Eigen::VectorXd neeq(static_cast<Eigen::Index>(_loop._n) * _loop._inputs[E]._rows);
+        for (auto* values : {&strains, &neeq})
+            for (Eigen::Index i = 0; i < values->size(); ++i)
+                (*values)[i] = uniform(generator);
+        return Check(strains, neeq.cwiseAbs());
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static double Seconds(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    //! @brief unbound values of the same shape and precision with own memory
+    static QValues Like(const QValues& values, int n)
+    {
+        if (not values.IsUsed())
+            return QValues();
+        QValues like(values._rows, values._cols, values._layout);
+        like._precision = values._precision;
+        like.Resize(n);
+        return like;
+    }
+
+    //! @brief evaluates all laws on the copies, returns the wall time
+    double Evaluate(bool tangents)
+    {
+        const auto start = Clock::now();
+        for (unsigned iLaw = 0; iLaw < _loop._laws.size(); ++iLaw)
+        {
+            LawInterface& law = *_loop._laws[iLaw];
+            const std::vector<int>& ips = _loop._ips[iLaw];
+            const int num_ips = ips.size();
+            if (auto* block_law = dynamic_cast<BlockLaw*>(&law))
+            {
+                block_law->EvaluateIPs(_inputs, _outputs, ips);
+                continue;
+            }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(_loop.NumThreads())
+#endif
+            for (int k = 0; k < num_ips; ++k)
+            {
+                if (tangents)
+                    law.Evaluate(_inputs, _outputs, ips[k]);
+                else
+                    law.EvaluateWithoutTangents(_inputs, _outputs, ips[k]);
+            }
+        }
+        return Seconds(start);
+    }
+
+    //! @brief central differences of the stresses w.r.t. the input `what`,
+    //! column major (q x size) per IP, like the tangent outputs
+    Eigen::VectorXd Differences(Q what)
+    {
+        const int n = _loop._n;
+        const int q = _outputs[SIGMA]._rows;
+        const int size = _inputs[what].Size();
+        const Eigen::VectorXd unperturbed = _inputs[what].Values();
+        Eigen::VectorXd differences(static_cast<Eigen::Index>(n) * q * size);
+
+        for (int j = 0; j < size; ++j)
+        {
+            Eigen::VectorXd perturbed = unperturbed;
+            for (int ip = 0; ip < n; ++ip)
+                perturbed[static_cast<Eigen::Index>(ip) * size + j] += _delta;
+            _inputs[what].SetValues(perturbed);
+            _stress_seconds += Evaluate(false);
+            const Eigen::VectorXd plus = _outputs[SIGMA].Values();
+
+            perturbed = unperturbed;
+            for (int ip = 0; ip < n; ++ip)
+                perturbed[static_cast<Eigen::Index>(ip) * size + j] -= _delta;
+            _inputs[what].SetValues(perturbed);
+            _stress_seconds += Evaluate(false);
+            const Eigen::VectorXd minus = _outputs[SIGMA].Values();
+
+            for (int ip = 0; ip < n; ++ip)
+                differences.segment(static_cast<Eigen::Index>(ip) * q * size + j * q, q) =
+                        (plus - minus).segment(static_cast<Eigen::Index>(ip) * q, q) / (2. * _delta);
+        }
+        _inputs[what].SetValues(unperturbed);
+        _stress_passes += 2 * size;
+        return differences;
+    }
+
+    //! @brief per IP errors of `tangents` w.r.t. `differences`, both with
+    //! the same number of values per IP
+    void Compare(const Eigen::VectorXd& tangents, const Eigen::VectorXd& differences, Eigen::VectorXd& errors) const
+    {
+        const int n = _loop._n;
+        const int size = n == 0 ? 0 : tangents.size() / n;
+        for (int ip = 0; ip < n; ++ip)
+        {
+            const auto tangent = tangents.segment(static_cast<Eigen::Index>(ip) * size, size);
+            const auto difference = differences.segment(static_cast<Eigen::Index>(ip) * size, size);
+            const double norm = std::max(tangent.norm(), difference.norm());
+            errors[ip] = norm == 0. ? 0. : (tangent - difference).norm() / norm;
+        }
+    }
+
+    IpLoop& _loop;
+    double _delta;
+    std::vector<QValues> _inputs = std::vector<QValues>(Q::LAST);
+    std::vector<QValues> _outputs = std::vector<QValues>(Q::LAST);
+    double _stress_seconds = 0.;
+    int _stress_passes = 0;
+};
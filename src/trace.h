@@ -0,0 +1,165 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//! @brief Opt-in timeline of the `IpLoop` phases, its law batches and the
+//! chunks of each thread, written as Chrome trace JSON, e.g. for
+//! chrome://tracing or the (offline) Perfetto UI.
+//!
+//! Each OS thread, OpenMP worker or e.g. python thread, appends to its own
+//! `thread_local` buffer, so recording only locks once per thread, at its
+//! first event. The "tid" of an event is the order of that first event. The
+//! buffers must only be read (`Json`, `Write`) or cleared while no thread
+//! records.
+class Tracer
+{
+public:
+    struct Event
+    {
+        const char* name;
+        int law;
+        double start;
+        double duration;
+    };
+
+    static Tracer& Instance()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    void Enable(bool enable)
+    {
+        _enabled = enable;
+    }
+
+    bool Enabled() const
+    {
+        return _enabled;
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto& buffer : _buffers)
+            buffer->clear();
+    }
+
+    //! @brief microseconds since the construction of the tracer
+    double Now() const
+    {
+        return std::chrono::duration<double, std::micro>(Clock::now() - _epoch).count();
+    }
+
+    //! @brief records `name` from `start` until now on the calling thread,
+    //! `law` is the index of the law in the `IpLoop` or -1. The name is not
+    //! escaped in the JSON.
+    void Complete(const char* name, int law, double start)
+    {
+        if (_enabled)
+            Buffer().push_back({name, law, start, Now() - start});
+    }
+
+    //! @brief as above, for names that are not string literals
+    void Complete(const std::string& name, double start)
+    {
+        if (not _enabled)
+            return;
+        const char* stored;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            stored = _names.insert(name).first->c_str();
+        }
+        Complete(stored, -1, start);
+    }
+
+    //! @brief all events as comma separated JSON objects, process `pid`
+    std::string Json(int pid = 0) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::ostringstream json;
+        json.precision(15);
+        bool first = true;
+        for (unsigned thread = 0; thread < _buffers.size(); ++thread)
+            for (const Event& event : *_buffers[thread])
+            {
+                json << (first ? "" : ",\n") << "{\"name\": \"" << event.name;
+                if (event.law >= 0)
+                    json << " (law " << event.law << ")";
+                json << "\", \"ph\": \"X\", \"ts\": " << event.start << ", \"dur\": " << event.duration
+                     << ", \"pid\": " << pid << ", \"tid\": " << thread << "}";
+                first = false;
+            }
+        return json.str();
+    }
+
+    void Write(const std::string& filename, int pid = 0) const
+    {
+        std::ofstream file(filename);
+        if (not file)
+            throw std::runtime_error("Cannot write the trace to " + filename + ".");
+        file << "{\"traceEvents\": [\n" << Json(pid) << "\n]}\n";
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Tracer()
+        : _epoch(Clock::now())
+    {
+    }
+
+    //! @brief the buffer of the calling thread, registered at its first use
+    std::vector<Event>& Buffer()
+    {
+        thread_local std::vector<Event>* buffer = nullptr;
+        if (not buffer)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _buffers.emplace_back(new std::vector<Event>());
+            buffer = _buffers.back().get();
+        }
+        return *buffer;
+    }
+
+    std::atomic<bool> _enabled{false};
+    Clock::time_point _epoch;
+    mutable std::mutex _mutex;
+    // owned here, such that they outlive their threads
+    std::vector<std::unique_ptr<std::vector<Event>>> _buffers;
+    std::set<std::string> _names;
+};
+
+//! @brief records its lifetime as an event of the `Tracer`
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name, int law = -1)
+        : _name(Tracer::Instance().Enabled() ? name : nullptr)
+        , _law(law)
+        , _start(_name ? Tracer::Instance().Now() : 0.)
+    {
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    ~TraceScope()
+    {
+        if (_name)
+            Tracer::Instance().Complete(_name, _law, _start);
+    }
+
+private:
+    const char* _name;
+    int _law;
+    double _start;
+};
@@ -0,0 +1,130 @@
+//! @brief Heap allocations per IP of the built-in laws in the hot path of the
+//! `IpLoop`, i.e. in `Evaluate` (with and without tangents) and `Update`
+//! after a first pass that allocates all buffers.
+//!
+//! The allocations are counted by interposing malloc, see
+//! benchmarks/allocations.h, which is not possible within the python
+//! module. Additionally, Eigen aborts on any allocation while the loop runs
+//! (EIGEN_RUNTIME_NO_MALLOC), which also names the offending expression in
+//! a debugger.
+//!
+//! The test fails if any of the built-in laws allocates in steady state.
+//! Other laws (e.g. from python) may allocate, so run it for them with
+//!
+//!     ./test_allocations --report
+//!
+//! which prints the allocations per IP of all laws without failing.
+#define EIGEN_RUNTIME_NO_MALLOC
+#include "allocations.h"
+#include "autodiff.h"
+#include "linear_elastic.h"
+#include "local_damage.h"
+#include "plasticity.h"
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+const int num_ips = 1000;
+
+//! @brief allocations per IP of `f`, with Eigen allocations forbidden if `strict`
+double AllocationsPerIP(const std::function<void()>& f, bool strict)
+{
+    Eigen::internal::set_is_malloc_allowed(not strict);
+    const long before = allocations::Count();
+    f();
+    const long allocated = allocations::Count() - before;
+    Eigen::internal::set_is_malloc_allowed(true);
+    return static_cast<double>(allocated) / num_ips;
+}
+
+//! @brief prints the allocations per IP of `law` and returns true, if it
+//! does not allocate in any of the measured calls
+bool Check(const std::string& name, std::shared_ptr<LawInterface> law, Constraint c, int threads, bool strict)
+{
+    IpLoop loop;
+    loop.AddLaw(law, {});
+    loop.Resize(num_ips);
+    loop.SetNumThreads(threads);
+
+    const Eigen::VectorXd strains = 1.e-3 * Eigen::VectorXd::Random(num_ips * Dim::Q(c));
+    const Eigen::VectorXd neeq = 0.5 * strains.head(num_ips).cwiseAbs();
+
+    // the first pass may allocate, e.g. the buffers of the loop
+    loop.Evaluate(strains, neeq);
+    loop.SetComputeTangents(false);
+    loop.Evaluate(strains, neeq);
+    loop.SetComputeTangents(true);
+    loop.Update(strains, neeq);
+
+    const double evaluate = AllocationsPerIP([&]() { loop.Evaluate(strains, neeq); }, strict);
+    loop.SetComputeTangents(false);
+    const double stress_only = AllocationsPerIP([&]() { loop.Evaluate(strains, neeq); }, strict);
+    loop.SetComputeTangents(true);
+    const double update = AllocationsPerIP([&]() { loop.Update(strains, neeq); }, strict);
+
+    std::cout << name << "/" << threads << " threads: " << evaluate << " (evaluate), " << stress_only
+              << " (without tangents), " << update << " (update) allocations per IP" << std::endl;
+    return evaluate == 0. and stress_only == 0. and update == 0.;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (not allocations::Enabled())
+    {
+        std::cout << "Allocations cannot be counted without glibc, skipped." << std::endl;
+        return 0;
+    }
+
+    // only report, e.g. for laws that are known to allocate
+    const bool report = argc > 1 and std::strcmp(argv[1], "--report") == 0;
+
+    // the OpenMP runtime only reuses its threads in steady state, which is
+    // checked as well
+    std::vector<int> threads = {1};
+#ifdef _OPENMP
+    threads.push_back(2);
+#endif
+
+    const double E = 20000., nu = 0.2;
+    const std::vector<std::pair<Constraint, std::string>> constraints = {{UNIAXIAL_STRAIN, "UNIAXIAL_STRAIN"},
+                                                                         {UNIAXIAL_STRESS, "UNIAXIAL_STRESS"},
+                                                                         {PLANE_STRAIN, "PLANE_STRAIN"},
+                                                                         {PLANE_STRESS, "PLANE_STRESS"},
+                                                                         {FULL, "FULL"}};
+    bool success = true;
+    for (int t : threads)
+        for (const auto& constraint : constraints)
+        {
+            const Constraint c = constraint.first;
+            auto omega = std::make_shared<DamageLawExponential>(1.e-4, 0.99, 100.);
+            auto norm = std::make_shared<ModMisesEeq>(10., nu, c);
+            auto linear_elastic = std::make_shared<LinearElastic>(E, nu, c);
+            auto local_damage = std::make_shared<LocalDamage>(E, nu, c, omega, norm);
+            auto gradient_damage = std::make_shared<GradientDamage>(E, nu, c, omega, norm);
+
+            const bool strict = not report;
+            success &= Check("LinearElastic/" + constraint.second,
+                             std::make_shared<MechanicsLawAdapter>(linear_elastic), c, t, strict);
+            success &= Check("LocalDamage/" + constraint.second, std::make_shared<MechanicsLawAdapter>(local_damage),
+                             c, t, strict);
+            success &= Check("GradientDamage/" + constraint.second, gradient_damage, c, t, strict);
+            success &= Check("AutoDiffLocalDamage/" + constraint.second,
+                             std::make_shared<AutoDiffLocalDamage>(E, nu, c, omega, norm), c, t, strict);
+            success &= Check("AutoDiffGradientDamage/" + constraint.second,
+                             std::make_shared<AutoDiffGradientDamage>(E, nu, c, omega, norm), c, t, strict);
+            // `VonMisesPlasticity` rejects the strain constraints
+            if (c == UNIAXIAL_STRESS or c == PLANE_STRESS or c == FULL)
+                success &= Check("VonMisesPlasticity/" + constraint.second,
+                                 std::make_shared<VonMisesPlasticity>(E, nu, c, 2., 1000.), c, t, strict);
+        }
+
+    if (report or success)
+        return 0;
+    std::cout << "The built-in laws must not allocate in steady state." << std::endl;
+    return 1;
+}
@@ -0,0 +1,74 @@
+import unittest
+import numpy as np
+import constitutive as c
+
+constraints = [
+    c.Constraint.UNIAXIAL_STRAIN,
+    c.Constraint.UNIAXIAL_STRESS,
+    c.Constraint.PLANE_STRAIN,
+    c.Constraint.PLANE_STRESS,
+    c.Constraint.FULL,
+]
+
+
+def damage_args(constraint):
+    return (
+        20000.0,
+        0.2,
+        constraint,
+        c.DamageLawExponential(k0=2.0e-4, alpha=0.99, beta=100.0),
+        c.ModMisesEeq(k=10.0, nu=0.2, constraint=constraint),
+    )
+
+
+class TestAutoDiff(unittest.TestCase):
+    """
+    The laws with automatically derived tangents must reproduce the hand
+    written ones, also after loading and unloading.
+    """
+
+    def compare(self, reference, autodiff, constraint, outputs):
+        n = 20
+        np.random.seed(6174)
+        eps = 1.0e-3 * (np.random.random(n * c.q_dim(constraint)) - 0.5)
+        e = 2.0e-3 * np.random.random(n)
+
+        loops = []
+        for law in [reference, autodiff]:
+            loop = c.IpLoop()
+            loop.add_law(law)
+            loop.resize(n)
+            loops.append(loop)
+
+        for factor in [1.0, 0.5, 2.0]:
+            for loop in loops:
+                loop.evaluate(factor * eps, factor * e)
+            for q in outputs:
+                expected = loops[0].get(q)
+                scale = max(np.max(np.abs(expected)), 1.0e-10)
+                np.testing.assert_allclose(loops[1].get(q) / scale, expected / scale, rtol=0, atol=1.0e-7)
+            for loop in loops:
+                loop.update(factor * eps, factor * e)
+        np.testing.assert_allclose(autodiff.kappa(), reference.kappa())
+
+    def test_local_damage(self):
+        for constraint in constraints:
+            self.compare(
+                c.LocalDamage(*damage_args(constraint)),
+                c.AutoDiffLocalDamage(*damage_args(constraint)),
+                constraint,
+                [c.Q.SIGMA, c.Q.DSIGMA_DEPS],
+            )
+
+    def test_gradient_damage(self):
+        for constraint in constraints:
+            self.compare(
+                c.GradientDamage(*damage_args(constraint)),
+                c.AutoDiffGradientDamage(*damage_args(constraint)),
+                constraint,
+                [c.Q.SIGMA, c.Q.DSIGMA_DEPS, c.Q.DSIGMA_DE, c.Q.EEQ, c.Q.DEEQ],
+            )
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,93 @@
+import unittest
+import numpy as np
+import constitutive as c
+
+
+class TestImplEx(unittest.TestCase):
+    """
+    With IMPL-EX, kappa is extrapolated from the last two committed steps and
+    the tangent is the symmetric secant stiffness.
+    """
+
+    def setUp(self):
+        self.constraint = c.Constraint.PLANE_STRAIN
+        self.omega = c.DamageLawExponential(k0=1.0e-4, alpha=0.99, beta=100.0)
+        self.norm = c.ModMisesEeq(k=10.0, nu=0.2, constraint=self.constraint)
+        self.elastic = c.LinearElastic(20000.0, 0.2, self.constraint)
+        self.eps = np.array([1.0, 0.3, 0.1])
+
+    def law(self, law_type):
+        return law_type(20000.0, 0.2, self.constraint, self.omega, self.norm)
+
+    def check(self, law):
+        law.set_impl_ex()
+        loop = c.IpLoop()
+        loop.add_law(law)
+        loop.resize(1)
+
+        kappa, kappa_old = 0.0, 0.0
+        for step in range(1, 5):
+            eps = step * 2.0e-4 * self.eps
+            eeq = np.array([self.norm.evaluate(eps)[0]])
+            loop.evaluate(eps, eeq)
+
+            omega = self.omega.evaluate(2 * kappa - kappa_old)[0]
+            stress, C = self.elastic.evaluate(eps)
+            np.testing.assert_allclose(loop.get(c.Q.SIGMA), (1.0 - omega) * stress)
+            tangent = loop.get(c.Q.DSIGMA_DEPS).reshape(3, 3)
+            np.testing.assert_allclose(tangent, (1.0 - omega) * C)
+
+            # the Jacobian does not change within the step
+            jacobian = [loop.get(q) for q in self.jacobian(law)]
+            loop.evaluate(1.1 * eps, 0.9 * eeq)
+            for q, expected in zip(self.jacobian(law), jacobian):
+                np.testing.assert_array_equal(loop.get(q), expected)
+
+            loop.update(eps, eeq)
+            kappa, kappa_old = max(kappa, eeq[0]), kappa
+        np.testing.assert_allclose(law.kappa(), [kappa])
+        return loop
+
+    @staticmethod
+    def jacobian(law):
+        if isinstance(law, c.GradientDamage):
+            return [c.Q.DSIGMA_DEPS, c.Q.DSIGMA_DE, c.Q.DEEQ]
+        return [c.Q.DSIGMA_DEPS]
+
+    def test_local_damage(self):
+        loop = self.check(self.law(c.LocalDamage))
+        # the symmetric tangent is stored packed
+        self.assertEqual(loop.memory()["q"][c.Q.DSIGMA_DEPS], 6 * 8)
+
+    def test_gradient_damage(self):
+        loop = self.check(self.law(c.GradientDamage))
+        # the coupled Jacobian is block diagonal
+        np.testing.assert_array_equal(loop.get(c.Q.DSIGMA_DE), 0.0)
+        np.testing.assert_array_equal(loop.get(c.Q.DEEQ), 0.0)
+
+    def test_step_ratio(self):
+        law = self.law(c.LocalDamage)
+        law.set_impl_ex()
+        loop = c.IpLoop()
+        loop.add_law(law)
+        loop.resize(1)
+        for step in [1, 2]:
+            loop.update(step * 5.0e-4 * self.eps)
+        kappa_old, kappa = [self.norm.evaluate(step * 5.0e-4 * self.eps)[0] for step in [1, 2]]
+
+        law.set_step_ratio(0.5)
+        loop.evaluate(self.eps)
+        omega = self.omega.evaluate(kappa + 0.5 * (kappa - kappa_old))[0]
+        np.testing.assert_allclose(loop.get(c.Q.SIGMA), (1.0 - omega) * self.elastic.evaluate(self.eps)[0])
+
+    def test_select_before_resize(self):
+        law = self.law(c.LocalDamage)
+        loop = c.IpLoop()
+        loop.add_law(law)
+        loop.resize(1)
+        with self.assertRaises(RuntimeError):
+            law.set_impl_ex()
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,565 @@
+import gc
+import json
+import sys
+import threading
+import time
+import unittest
+import numpy as np
+import constitutive as c
+
+
+def local_damage(constraint):
+    return c.LocalDamage(
+        20000.0,
+        0.2,
+        constraint,
+        c.DamageLawExponential(k0=2.0e-4, alpha=0.99, beta=100.0),
+        c.ModMisesEeq(k=10.0, nu=0.2, constraint=constraint),
+    )
+
+
+class TestIncremental(unittest.TestCase):
+    def setUp(self):
+        self.constraint = c.Constraint.PLANE_STRAIN
+        self.n = 100
+        np.random.seed(6174)
+        self.eps = np.random.random(self.n * 3) * 1.0e-3
+
+    def loop(self, law):
+        loop = c.IpLoop()
+        loop.add_law(law)
+        loop.resize(self.n)
+        return loop
+
+    def test_only_changed_ips(self):
+        law = local_damage(self.constraint)
+        loop = self.loop(law)
+        loop.set_incremental(1.0e-10)
+
+        loop.evaluate(self.eps)
+        self.assertAlmostEqual(loop.dirty_fraction(), 1.0)
+
+        loop.evaluate(self.eps)
+        self.assertAlmostEqual(loop.dirty_fraction(), 0.0)
+
+        eps = self.eps.copy()
+        eps[30:36] *= 2.0
+        loop.evaluate(eps)
+        self.assertAlmostEqual(loop.dirty_fraction(), 0.02)
+
+        reference = self.loop(local_damage(self.constraint))
+        reference.evaluate(eps)
+        for q in [c.Q.SIGMA, c.Q.DSIGMA_DEPS]:
+            self.assertLess(np.linalg.norm(loop.get(q) - reference.get(q)), 1.0e-10)
+
+    def test_tolerance(self):
+        loop = self.loop(local_damage(self.constraint))
+        loop.set_incremental(1.0e-6)
+        loop.evaluate(self.eps)
+
+        # changes below the tolerance are ignored ...
+        loop.evaluate(self.eps + 0.6e-6)
+        self.assertAlmostEqual(loop.dirty_fraction(), 0.0)
+
+        # ... but they do not accumulate unnoticed.
+        loop.evaluate(self.eps + 1.2e-6)
+        self.assertAlmostEqual(loop.dirty_fraction(), 1.0)
+
+    def test_nan(self):
+        """
+        A NaN in the inputs must reach the outputs instead of being
+        skipped as unchanged.
+        """
+        loop = self.loop(local_damage(self.constraint))
+        loop.set_incremental(1.0e-6)
+        loop.evaluate(self.eps)
+
+        eps = self.eps.copy()
+        eps[30] = np.nan
+        loop.evaluate(eps)
+        self.assertAlmostEqual(loop.dirty_fraction(), 0.01)
+        self.assertTrue(np.isnan(loop.get(c.Q.SIGMA)[30:33]).all())
+
+        loop.evaluate(self.eps)
+        self.assertAlmostEqual(loop.dirty_fraction(), 0.01)
+        self.assertFalse(np.isnan(loop.get(c.Q.SIGMA)).any())
+
+    def test_update_invalidates(self):
+        loop = self.loop(local_damage(self.constraint))
+        loop.set_incremental()
+        loop.evaluate(self.eps)
+        loop.update(self.eps)
+        loop.evaluate(self.eps)
+        self.assertAlmostEqual(loop.dirty_fraction(), 1.0)
+
+    def test_disabled(self):
+        loop = self.loop(local_damage(self.constraint))
+        loop.evaluate(self.eps)
+        loop.evaluate(self.eps)
+        self.assertAlmostEqual(loop.dirty_fraction(), 1.0)
+
+
+class TestHistory(unittest.TestCase):
+    """
+    The history of a law lives in the arena of its loop, but belongs to
+    the law.
+    """
+
+    def setUp(self):
+        self.constraint = c.Constraint.PLANE_STRAIN
+        self.n = 10
+        np.random.seed(6174)
+        self.eps = np.random.random(self.n * 3) * 1.0e-3
+
+    def loop(self, law):
+        loop = c.IpLoop()
+        loop.add_law(law)
+        loop.resize(self.n)
+        return loop
+
+    def test_law_outlives_loop(self):
+        law = local_damage(self.constraint)
+        loop = self.loop(law)
+        loop.update(self.eps)
+        kappa = law.kappa()
+        self.assertGreater(np.max(kappa), 0.0)
+
+        del loop
+        gc.collect()
+        np.testing.assert_array_equal(law.kappa(), kappa)
+        law.update(10.0 * self.eps[:3], 0)
+        self.assertGreater(law.kappa()[0], kappa[0])
+
+        # usable in a new loop, which starts from the virgin state
+        loop = self.loop(law)
+        np.testing.assert_array_equal(law.kappa(), np.zeros(self.n))
+
+    def test_one_loop_at_a_time(self):
+        law = local_damage(self.constraint)
+        loop = self.loop(law)
+        with self.assertRaises(RuntimeError):
+            self.loop(law)
+
+    def test_settings_keep_history(self):
+        law = local_damage(self.constraint)
+        loop = self.loop(law)
+        loop.evaluate(self.eps)
+        loop.update(self.eps)
+        kappa, sigma = law.kappa(), loop.get(c.Q.SIGMA)
+
+        loop.set_num_threads(2)
+        loop.set_arena_layout(c.ArenaLayout.INTERLEAVED)
+        np.testing.assert_array_equal(law.kappa(), kappa)
+        np.testing.assert_array_equal(loop.get(c.Q.SIGMA), sigma)
+
+        loop.set_precision(c.Q.SIGMA, c.Precision.SINGLE)
+        np.testing.assert_array_equal(law.kappa(), kappa)
+        np.testing.assert_allclose(loop.get(c.Q.SIGMA), sigma, rtol=1.0e-6)
+
+
+class TestThreads(unittest.TestCase):
+    """
+    The material passes release the GIL, so two python threads evaluate two
+    loops at the same time and other python threads keep running.
+    """
+
+    def setUp(self):
+        n, constraint = 100000, c.Constraint.PLANE_STRESS
+        np.random.seed(6174)
+        self.eps = 0.05 * (np.random.random(3 * n) - 0.5)
+
+        self.loops = []
+        for _ in range(3):
+            loop = c.IpLoop()
+            loop.add_law(c.VonMisesPlasticity(1000.0, 0.3, constraint, 10.0, 100.0))
+            loop.resize(n)
+            self.loops.append(loop)
+
+    def test_concurrent_loops(self):
+        self.loops[2].evaluate(self.eps)  # serial reference
+        threads = [threading.Thread(target=loop.evaluate, args=(self.eps,)) for loop in self.loops[:2]]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        for loop in self.loops[:2]:
+            np.testing.assert_array_equal(loop.get(c.Q.SIGMA), self.loops[2].get(c.Q.SIGMA))
+            np.testing.assert_array_equal(loop.get(c.Q.DSIGMA_DEPS), self.loops[2].get(c.Q.DSIGMA_DEPS))
+
+    def test_gil_released(self):
+        """
+        With a huge switch interval, the main thread only gives up the GIL
+        where it blocks. The counting thread can only see `inside` set, if
+        `evaluate` released it.
+        """
+        state = {"inside": False, "during": 0, "stop": False}
+
+        def count():
+            while not state["stop"]:
+                if state["inside"]:
+                    state["during"] += 1
+                time.sleep(1.0e-4)
+
+        interval = sys.getswitchinterval()
+        sys.setswitchinterval(1000.0)
+        counter = threading.Thread(target=count)
+        try:
+            counter.start()
+            for _ in range(20):
+                state["inside"] = True
+                self.loops[0].evaluate(self.eps)
+                state["inside"] = False
+                if state["during"] > 0:
+                    break
+        finally:
+            state["stop"] = True
+            counter.join()
+            sys.setswitchinterval(interval)
+        self.assertGreater(state["during"], 0)
+
+
+class TestStats(unittest.TestCase):
+    def test_counters(self):
+        n = 100
+        np.random.seed(6174)
+        eps = np.random.random(n * 3) * 1.0e-3
+
+        loop = c.IpLoop()
+        loop.add_law(local_damage(c.Constraint.PLANE_STRAIN))
+        loop.resize(n)
+        loop.set_record_stats()
+        loop.set_incremental(1.0e-10)
+        for _ in range(3):
+            loop.evaluate(eps)
+        loop.update(eps)
+
+        stats = loop.stats()[0]
+        self.assertEqual(stats["evaluate_calls"], 3)
+        self.assertEqual(stats["evaluated_ips"], n)
+        self.assertEqual(stats["update_calls"], 1)
+        self.assertEqual(stats["loading_ips"], n)
+        self.assertEqual(stats["max_calls_per_step"], 3)
+        self.assertGreater(stats["evaluate_time"], 0.0)
+
+        # unload the first half, load the second half further
+        eps[: n // 2 * 3] *= 0.5
+        eps[n // 2 * 3 :] *= 2.0
+        loop.update(eps)
+        stats = loop.stats()[0]
+        self.assertEqual(stats["loading_ips"], n + n // 2)
+        self.assertEqual(stats["unloading_ips"], n // 2)
+
+        loop.reset_stats()
+        self.assertEqual(loop.stats()[0]["evaluate_calls"], 0)
+
+
+class TestTrace(unittest.TestCase):
+    def tearDown(self):
+        c.Tracer.enable(False)
+        c.Tracer.clear()
+
+    def test_events(self):
+        loop = c.IpLoop()
+        loop.add_law(local_damage(c.Constraint.PLANE_STRAIN))
+        loop.resize(10)
+
+        c.Tracer.enable()
+        start = c.Tracer.now()
+        loop.evaluate(np.zeros(30))
+        c.Tracer.complete("solve", start)
+
+        events = json.loads("[" + c.Tracer.json(pid=3) + "]")
+        names = [event["name"] for event in events]
+        self.assertIn("IpLoop::Evaluate", names)
+        self.assertIn("evaluate (law 0)", names)
+        self.assertIn("solve", names)
+        self.assertTrue(all(event["pid"] == 3 for event in events))
+
+    def test_threads(self):
+        """
+        Two python threads evaluate their own loops, their events end up in
+        their own buffers.
+        """
+        loops = []
+        for _ in range(2):
+            loop = c.IpLoop()
+            loop.add_law(local_damage(c.Constraint.PLANE_STRAIN))
+            loop.resize(1000)
+            loops.append(loop)
+
+        def evaluate(loop):
+            for _ in range(20):
+                loop.evaluate(np.zeros(3000))
+                c.Tracer.complete("step", c.Tracer.now())
+
+        c.Tracer.enable()
+        threads = [threading.Thread(target=evaluate, args=(loop,)) for loop in loops]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        events = json.loads("[" + c.Tracer.json() + "]")
+        evaluations = [event for event in events if event["name"] == "IpLoop::Evaluate"]
+        self.assertEqual(len(evaluations), 40)
+        self.assertEqual(len([event for event in events if event["name"] == "step"]), 40)
+        self.assertEqual(len({event["tid"] for event in evaluations}), 2)
+
+
+class TestTangentCheck(unittest.TestCase):
+    def test_local_damage(self):
+        n = 100
+        np.random.seed(6174)
+        eps = np.random.random(n * 3) * 1.0e-3
+
+        law = local_damage(c.Constraint.PLANE_STRAIN)
+        loop = c.IpLoop()
+        loop.add_law(law)
+        loop.resize(n)
+        loop.set_num_threads(2)
+        loop.evaluate(eps)
+        loop.update(eps)
+        kappa, sigma = law.kappa(), loop.get(c.Q.SIGMA)
+
+        errors = c.check_tangents(loop, 1.1 * eps, delta=1.0e-9)
+        self.assertLess(np.max(errors.dsigma_deps), 1.0e-6)
+        self.assertTrue(np.all(np.isnan(errors.dsigma_de)))
+        self.assertGreater(errors.time, errors.tangent_time)
+
+        errors = c.check_tangents_random(loop, amplitude=1.0e-3, delta=1.0e-9)
+        self.assertEqual(len(errors.dsigma_deps), n)
+        self.assertLess(np.max(errors.dsigma_deps), 1.0e-6)
+
+        # neither the history nor the outputs of the loop changed
+        np.testing.assert_array_equal(law.kappa(), kappa)
+        np.testing.assert_array_equal(loop.get(c.Q.SIGMA), sigma)
+
+    def test_gradient_damage(self):
+        constraint = c.Constraint.PLANE_STRAIN
+        law = c.GradientDamage(
+            20000.0,
+            0.2,
+            constraint,
+            c.DamageLawExponential(k0=2.0e-4, alpha=0.99, beta=100.0),
+            c.ModMisesEeq(k=10.0, nu=0.2, constraint=constraint),
+        )
+        loop = c.IpLoop()
+        loop.add_law(law)
+        loop.resize(50)
+
+        errors = c.check_tangents_random(loop, amplitude=1.0e-3, seed=1, delta=1.0e-9)
+        self.assertLess(np.max(errors.dsigma_deps), 1.0e-6)
+        self.assertLess(np.max(errors.dsigma_de), 1.0e-6)
+
+
+class TestStorage(unittest.TestCase):
+    def test_symmetric_tangent(self):
+        constraint = c.Constraint.FULL
+        n = 10
+        law = c.LinearElastic(20000.0, 0.2, constraint)
+        loop = c.IpLoop()
+        loop.add_law(law)
+        loop.resize(n)
+
+        np.random.seed(6174)
+        eps = np.random.random(n * 6)
+        loop.evaluate(eps)
+
+        _, C = law.evaluate(eps[:6])
+        dsigma = loop.get(c.Q.DSIGMA_DEPS).reshape(n, 6, 6)
+        for i in range(n):
+            self.assertLess(np.linalg.norm(dsigma[i] - C), 1.0e-10)
+
+    def test_mixed_symmetry(self):
+        constraint = c.Constraint.PLANE_STRAIN
+        n = 10
+        elastic = c.LinearElastic(20000.0, 0.2, constraint)
+        damage = local_damage(constraint)
+        loop = c.IpLoop()
+        loop.add_law(elastic, np.arange(0, 5))
+        loop.add_law(damage, np.arange(5, 10))
+        loop.resize(n)
+
+        np.random.seed(6174)
+        eps = np.random.random(n * 3) * 1.0e-3
+        loop.evaluate(eps)
+
+        # The damage tangent is not symmetric and must not be packed.
+        dsigma = loop.get(c.Q.DSIGMA_DEPS).reshape(n, 9)
+        for i in range(5, 10):
+            _, reference = damage.evaluate(eps[3 * i : 3 * i + 3], i)
+            self.assertLess(np.linalg.norm(dsigma[i] - reference.flatten("F")), 1.0e-10)
+
+    def test_arena_layouts(self):
+        constraint = c.Constraint.PLANE_STRAIN
+        n = 100
+        np.random.seed(6174)
+        eps = np.random.random(n * 3) * 1.0e-3
+
+        results = []
+        for layout in [c.ArenaLayout.BLOCKED, c.ArenaLayout.INTERLEAVED]:
+            for num_threads in [1, 3]:
+                law = local_damage(constraint)
+                loop = c.IpLoop()
+                loop.set_arena_layout(layout)
+                loop.set_num_threads(num_threads)
+                loop.add_law(law)
+                loop.resize(n)
+                loop.evaluate(eps)
+                loop.update(eps)
+                loop.evaluate(2.0 * eps)
+                results.append(
+                    np.concatenate([loop.get(c.Q.SIGMA), loop.get(c.Q.DSIGMA_DEPS), law.kappa()])
+                )
+
+        for result in results[1:]:
+            self.assertLess(np.linalg.norm(result - results[0]), 1.0e-10)
+
+    def test_memory(self):
+        n = 10
+        loop = c.IpLoop()
+        loop.add_law(c.LinearElastic(20000.0, 0.2, c.Constraint.PLANE_STRAIN), list(range(5)))
+        loop.add_law(local_damage(c.Constraint.PLANE_STRAIN), list(range(5, n)))
+        loop.resize(n)
+
+        memory = loop.memory()
+        self.assertEqual(memory["q"][c.Q.EPS], n * 3 * 8)
+        self.assertEqual(memory["q"][c.Q.SIGMA], n * 3 * 8)
+        self.assertEqual(memory["q"][c.Q.DSIGMA_DEPS], n * 9 * 8)  # LocalDamage is not symmetric
+        self.assertEqual(memory["histories"], [0, n * 8])
+        self.assertEqual(memory["other"], n * 4)  # the IPs of the laws
+        self.assertEqual(
+            memory["total"], sum(memory["q"].values()) + n * 8 + memory["padding"] + memory["other"]
+        )
+        self.assertAlmostEqual(memory["bytes_per_ip"], memory["total"] / n)
+
+        loop.set_precision(c.Q.DSIGMA_DEPS, c.Precision.SINGLE)
+        self.assertEqual(loop.memory()["q"][c.Q.DSIGMA_DEPS], n * 9 * 4)
+
+    def test_memory_outside_of_the_arena(self):
+        n = 16
+        loop = c.IpLoop()
+        loop.add_law(c.VonMisesPlasticity(1000.0, 0.3, c.Constraint.PLANE_STRESS, 10.0, 100.0))
+        loop.resize(n)
+        loop.evaluate(np.zeros(n * 3))
+        # IPs, dirty flags (bits) and the substeps of the law
+        self.assertEqual(loop.memory()["other"], n * 4 + n // 8 + n * 4)
+
+        loop.set_incremental(1.0e-10)
+        loop.evaluate(np.zeros(n * 3))
+        self.assertEqual(loop.memory()["other"], n * 4 + n // 8 + n * 4 + n * 3 * 8)
+
+    def test_wrong_input_size(self):
+        loop = c.IpLoop()
+        loop.add_law(c.LinearElastic(20000.0, 0.2, c.Constraint.FULL))
+        loop.resize(3)
+        self.assertRaises(RuntimeError, loop.evaluate, np.zeros(5))
+
+    def elastic(self, n):
+        loop = c.IpLoop()
+        loop.add_law(c.LinearElastic(20000.0, 0.2, c.Constraint.FULL))
+        loop.set_precision(c.Q.DSIGMA_DEPS, c.Precision.SINGLE)
+        loop.resize(n)
+        np.random.seed(6174)
+        loop.evaluate(np.random.random(n * 6))
+        return loop
+
+    def test_write_to(self):
+        n = 3
+        loop = self.elastic(n)
+        for what, size in [(c.Q.SIGMA, 6), (c.Q.DSIGMA_DEPS, 36)]:
+            # the values arrive in the given array, it is not copied
+            values = np.zeros(n * size)
+            loop.write_to(what, values)
+            np.testing.assert_array_equal(values, loop.get(what))
+
+        # a strided view or another dtype would require a copy
+        values = np.zeros(2 * n * 6)
+        self.assertRaises(TypeError, loop.write_to, c.Q.SIGMA, values[::2])
+        self.assertRaises(TypeError, loop.write_to, c.Q.SIGMA, np.zeros(n * 6, dtype=np.float32))
+
+    def test_write_to_wrong_size(self):
+        loop = self.elastic(3)
+        self.assertRaises(RuntimeError, loop.write_to, c.Q.SIGMA, np.zeros(5))
+
+
+class NumpyElastic(c.BlockLaw):
+    """
+    Linear elasticity on whole numpy blocks with a (pointless) history
+    """
+
+    def __init__(self, constraint):
+        q = c.q_dim(constraint)
+        super().__init__(inputs={c.Q.EPS: (q, 1)}, outputs={c.Q.SIGMA: (q, 1), c.Q.DSIGMA_DEPS: (q, q)})
+        _, self.C = c.LinearElastic(20000.0, 0.2, constraint).evaluate(np.zeros(q))
+        self.calls = 0
+        self.max_eps = None
+
+    def evaluate(self, inputs, outputs):
+        self.calls += 1
+        outputs[c.Q.SIGMA][:] = inputs[c.Q.EPS] @ self.C.T
+        outputs[c.Q.DSIGMA_DEPS][:] = self.C
+
+    def update(self, inputs):
+        self.max_eps = np.max(inputs[c.Q.EPS], axis=1)
+
+
+class TestBlockLaw(unittest.TestCase):
+    def setUp(self):
+        self.constraint = c.Constraint.PLANE_STRAIN
+        self.n = 10
+        np.random.seed(6174)
+        self.eps = np.random.random(self.n * 3)
+
+    def reference(self):
+        loop = c.IpLoop()
+        loop.add_law(c.LinearElastic(20000.0, 0.2, self.constraint))
+        loop.resize(self.n)
+        loop.evaluate(self.eps)
+        return loop
+
+    def check(self, loop, law):
+        loop.evaluate(self.eps)
+        self.assertEqual(law.calls, 1)
+        reference = self.reference()
+        for what in [c.Q.SIGMA, c.Q.DSIGMA_DEPS]:
+            np.testing.assert_allclose(loop.get(what), reference.get(what), rtol=1.0e-6)
+
+    def test_all_ips(self):
+        law = NumpyElastic(self.constraint)
+        loop = c.IpLoop()
+        loop.add_law(law)
+        loop.resize(self.n)
+        self.check(loop, law)
+
+        loop.update(self.eps)
+        self.assertEqual(len(law.max_eps), self.n)
+
+    def test_mixed_with_native_law(self):
+        law = NumpyElastic(self.constraint)
+        loop = c.IpLoop()
+        loop.add_law(law, [0, 3, 4, 9])
+        loop.add_law(c.LinearElastic(20000.0, 0.2, self.constraint), [1, 2, 5, 6, 7, 8])
+        loop.set_precision(c.Q.DSIGMA_DEPS, c.Precision.SINGLE)
+        loop.resize(self.n)
+        self.check(loop, law)
+
+        loop.update(self.eps)
+        self.assertEqual(len(law.max_eps), 4)
+
+    def test_without_reference(self):
+        """
+        The loop keeps the python law alive.
+        """
+        loop = c.IpLoop()
+        loop.add_law(NumpyElastic(self.constraint))
+        gc.collect()
+        loop.resize(self.n)
+        loop.evaluate(self.eps)
+        np.testing.assert_allclose(loop.get(c.Q.SIGMA), self.reference().get(c.Q.SIGMA), rtol=1.0e-6)
+        loop.update(self.eps)
+
+
+if __name__ == "__main__":
+    unittest.main()
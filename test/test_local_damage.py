@@ -51,7 +51,11 @@ class TestUniaxial(unittest.TestCase):
         self.assertLess(np.max(np.abs(sigma)), 1.0e-10)
         self.assertFalse(np.any(np.isnan(dsigma)))
 
-    def test_uniaxial(self):
+    def uniaxial(self, precision=c.Precision.DOUBLE, tangent_reuse=None):
+        """
+        Returns the Newton iterations and, with `tangent_reuse`, the
+        assembled tangents of each load step, and the loads.
+        """
         prm = c.Parameters(c.Constraint.UNIAXIAL_STRESS)
         prm.deg_d = 1
         prm.alpha = 0.999
@@ -61,7 +65,12 @@ class TestUniaxial(unittest.TestCase):
         law = law_from_prm(prm)
 
         mesh = df.UnitIntervalMesh(1)
-        problem = c.MechanicsProblem(mesh, prm, law)
+        # Only the tangent is stored in `precision`. Single precision
+        # stresses would limit the attainable accuracy of the residual.
+        iploop = c.IpLoop()
+        iploop.set_precision(c.Q.DSIGMA_DEPS, precision)
+        problem = c.MechanicsProblem(mesh, prm, law, iploop)
+        problem.tangent_reuse = tangent_reuse
 
         bc0 = df.DirichletBC(problem.Vd, [0], boundary.plane_at(0))
         bc_expr = df.Expression(["u"], u=0, degree=0)
@@ -75,19 +84,77 @@ class TestUniaxial(unittest.TestCase):
 
         solver = df.NewtonSolver()
         solver.parameters["linear_solver"] = "mumps"
-        solver.parameters["maximum_iterations"] = 10
+        solver.parameters["maximum_iterations"] = 10 if tangent_reuse is None else 30
         solver.parameters["error_on_nonconvergence"] = False
 
         u_max = 100 * k0
+        iterations, assembled = [], []
         for u in np.linspace(0, u_max, 101):
             bc_expr.u = u
-            converged = solver.solve(problem, problem.u.vector())
+            before = tangent_reuse.num_assembled if tangent_reuse else 0
+            n, converged = solver.solve(problem, problem.u.vector())
             assert converged
+            iterations.append(n)
+            assembled.append(tangent_reuse.num_assembled - before if tangent_reuse else n)
             problem.update()
             ld(u, df.assemble(problem.R))
 
         GF = np.trapz(ld.load, ld.disp)
         self.assertAlmostEqual(GF, 0.5 * k0 ** 2 * prm.E + prm.gf, delta=prm.gf / 100)
+        return np.array(iterations), np.array(assembled), np.array(ld.load)
+
+    def test_uniaxial(self):
+        self.uniaxial()
+
+    def test_uniaxial_modified_newton(self):
+        _, _, expected = self.uniaxial()
+
+        # every third Jacobian, counted across the load steps
+        reuse = c.TangentReuse(every=3)
+        iterations, assembled, load = self.uniaxial(tangent_reuse=reuse)
+        calls = np.cumsum(np.concatenate([[0], iterations]))
+        for n, first, last in zip(assembled, calls[:-1], calls[1:]):
+            self.assertEqual(n, sum(1 for call in range(first, last) if call % 3 == 0))
+        self.assertEqual(reuse.num_assembled + reuse.num_reused, np.sum(iterations))
+        np.testing.assert_allclose(load, expected, rtol=1.0e-6, atol=1.0e-6 * np.max(np.abs(expected)))
+
+        # The first, large residual of a load step does not count as degraded.
+        reuse = c.TangentReuse(every=10, ratio=0.5)
+        iterations, assembled, load = self.uniaxial(tangent_reuse=reuse)
+        self.assertTrue(np.all(assembled <= iterations))
+        self.assertTrue(np.any((assembled < iterations) & (iterations > 0)))
+        self.assertEqual(reuse.num_assembled + reuse.num_reused, np.sum(iterations))
+        np.testing.assert_allclose(load, expected, rtol=1.0e-6, atol=1.0e-6 * np.max(np.abs(expected)))
+
+    def test_uniaxial_single_precision(self):
+        iterations_double = np.sum(self.uniaxial(c.Precision.DOUBLE)[0])
+        iterations_single = np.sum(self.uniaxial(c.Precision.SINGLE)[0])
+        self.assertLessEqual(iterations_single, 1.1 * iterations_double)
+
+
+class TestTangentReuse(unittest.TestCase):
+    def test_new_step(self):
+        reuse = c.TangentReuse(every=10, ratio=0.5)
+        reuse.residual(1.0)
+        self.assertTrue(reuse.assemble())
+        reuse.residual(0.1)
+        self.assertFalse(reuse.assemble())
+        reuse.residual(1.0e-12)
+        reuse.new_step()
+
+        # the first residual of the next step is not compared to the last one
+        reuse.residual(1.0)
+        self.assertFalse(reuse.assemble())
+        reuse.residual(0.9)
+        self.assertTrue(reuse.assemble())
+        self.assertEqual((reuse.num_assembled, reuse.num_reused), (2, 2))
+
+    def test_required(self):
+        reuse = c.TangentReuse(every=10)
+        self.assertTrue(reuse.assemble())
+        self.assertTrue(reuse.assemble(required=True))
+        self.assertFalse(reuse.assemble())
+        self.assertEqual((reuse.num_assembled, reuse.num_reused), (2, 1))
 
 
 if __name__ == "__main__":
@@ -101,10 +101,11 @@ class DisplacementSolution(UserExpression):
 
 
 class TestPlate(unittest.TestCase):
-    def test_plate(self):
+    def plate(self, fused_assembly, loads=(1.0,)):
         L, radius = 4.0, 1.0
 
         prm = c.Parameters(c.Constraint.PLANE_STRESS)
+        prm.fused_assembly = fused_assembly
 
         plate_with_hole = PlateWithHoleSolution(L=L, E=prm.E, nu=prm.nu, radius=radius)
         mesh = Mesh()
@@ -114,7 +115,8 @@ class TestPlate(unittest.TestCase):
 
         n = FacetNormal(mesh)
         stress = StressSolution(plate_with_hole, degree=2)
-        traction = dot(stress, n)
+        load = Constant(loads[0])
+        traction = load * dot(stress, n)
 
         problem = c.MechanicsProblem(
             mesh, prm, c.LinearElastic(prm.E, prm.nu, prm.constraint)
@@ -123,11 +125,25 @@ class TestPlate(unittest.TestCase):
         bc1 = DirichletBC(problem.Vd.sub(1), 0.0, boundary.plane_at(0, "y"))
         problem.set_bcs([bc0, bc1])
         problem.add_force_term(dot(TestFunction(problem.Vd), traction) * ds)
-        u = problem.solve()
+        for value in loads:
+            load.assign(value)
+            u = problem.solve()
 
         disp = DisplacementSolution(plate_with_hole, degree=2)
-        error = errornorm(disp, u)
-        self.assertLess(error, 1.0e-6)
+        return errornorm(disp, u)
+
+    def test_plate(self):
+        self.assertLess(self.plate(fused_assembly=False), 1.0e-6)
+
+    def test_plate_fused_assembly(self):
+        self.assertLess(self.plate(fused_assembly=True), 1.0e-6)
+
+    def test_plate_fused_assembly_load_steps(self):
+        """
+        The fused assembly assembles the forces once per load step, the
+        changed load of the second step must still be applied.
+        """
+        self.assertLess(self.plate(fused_assembly=True, loads=(2.0, 1.0)), 1.0e-6)
 
 
 if __name__ == "__main__":
@@ -0,0 +1,88 @@
+import unittest
+import dolfin as df
+import numpy as np
+import constitutive as c
+
+
+class TestQuadratureStrains(unittest.TestCase):
+    def compare(self, mesh, constraint, deg_d, deg_q):
+        """
+        The strains of the BOperator must match the projected ones.
+        """
+        prm = c.Parameters(constraint)
+        prm.deg_d, prm.deg_q = deg_d, deg_q
+        problem = c.MechanicsProblem(mesh, prm, c.LinearElastic(prm.E, prm.nu, constraint))
+        self.assertIsInstance(problem.calculate_eps, c.helper.QuadratureStrains)
+
+        np.random.seed(6174)
+        problem.d.vector()[:] = np.random.random(problem.d.vector().local_size())
+
+        VQV = problem.q_eps.function_space()
+        projector = c.helper.LocalProjector(problem.eps(problem.d), VQV, problem.dxm)
+        expected = df.Function(VQV)
+        projector(expected)
+
+        problem.calculate_eps(problem.q_eps)
+        np.testing.assert_allclose(problem.q_eps.vector().get_local(), expected.vector().get_local(), atol=1.0e-10)
+
+        # directly into the IpLoop
+        problem.calculate_eps(problem.iploop)
+        problem.iploop.evaluate()
+        sigma = problem.iploop.get(c.Q.SIGMA)
+        problem.iploop.evaluate(expected.vector().get_local())
+        np.testing.assert_allclose(sigma, problem.iploop.get(c.Q.SIGMA), atol=1.0e-6)
+
+    def test_1d(self):
+        self.compare(df.UnitIntervalMesh(5), c.Constraint.UNIAXIAL_STRAIN, 2, 2)
+
+    def test_2d(self):
+        mesh = df.UnitSquareMesh(3, 4)
+        for deg_d, deg_q in [(1, 1), (1, 2), (2, 2), (2, 3)]:
+            self.compare(mesh, c.Constraint.PLANE_STRAIN, deg_d, deg_q)
+
+    def test_3d(self):
+        self.compare(df.UnitCubeMesh(2, 2, 2), c.Constraint.FULL, 2, 2)
+
+
+class TestQuadratureValues(unittest.TestCase):
+    """
+    `get_q` and `write_q` read and write the local values of quadrature
+    functions, directly or via the copies for a python IpLoop.
+    """
+
+    def setUp(self):
+        constraint = c.Constraint.PLANE_STRAIN
+        mesh = df.UnitSquareMesh(2, 3)
+        _, VQV, _ = c.helper.spaces(mesh, 2, c.q_dim(constraint))
+        self.q_eps, self.q_sigma = df.Function(VQV), df.Function(VQV)
+        n = len(self.q_eps.vector().get_local()) // 3
+
+        np.random.seed(6174)
+        c.helper.set_q(self.q_eps, np.random.random(n * 3))
+        self.loop = c.IpLoop()
+        self.loop.add_law(c.LinearElastic(20000.0, 0.2, constraint))
+        self.loop.resize(n)
+
+    def test_get_q(self):
+        eps = c.helper.get_q(self.q_eps)
+        np.testing.assert_array_equal(eps, self.q_eps.vector().get_local())
+        if df.has_petsc4py():
+            self.assertFalse(eps.flags.writeable)
+
+    def test_write_q(self):
+        self.loop.evaluate(c.helper.get_q(self.q_eps))
+        c.helper.write_q(self.q_sigma, self.loop, c.Q.SIGMA)
+        np.testing.assert_array_equal(self.q_sigma.vector().get_local(), self.loop.get(c.Q.SIGMA))
+
+    def test_write_q_python_loop(self):
+        class PythonLoop:
+            def __init__(self, loop):
+                self.get = loop.get
+
+        self.loop.evaluate(c.helper.get_q(self.q_eps))
+        c.helper.write_q(self.q_sigma, PythonLoop(self.loop), c.Q.SIGMA)
+        np.testing.assert_array_equal(self.q_sigma.vector().get_local(), self.loop.get(c.Q.SIGMA))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,115 @@
+import unittest
+import numpy as np
+import constitutive as c
+
+
+class TestSubstepping(unittest.TestCase):
+    """
+    A strain increment that is too large for the local Newton method of the
+    return mapping is subdivided only at the IPs where it fails.
+    """
+
+    def setUp(self):
+        self.constraint = c.Constraint.PLANE_STRESS
+        self.sig0, self.H = 10.0, 100.0
+        # IP 0 stays elastic, the others yield with increasing strains
+        direction = np.array([1.0, -0.4, 0.7])
+        self.eps = np.concatenate([f * direction for f in [0.001, 0.05, 0.1, 0.15]])
+
+    def loop(self, max_iterations, max_substeps):
+        law = c.VonMisesPlasticity(1000.0, 0.3, self.constraint, self.sig0, self.H)
+        law.set_return_mapping(max_iterations=max_iterations)
+        law.set_max_substeps(max_substeps)
+        loop = c.IpLoop()
+        loop.add_law(law)
+        loop.resize(4)
+        return loop, law
+
+    def test_failing_ips_only(self):
+        loop, law = self.loop(max_iterations=3, max_substeps=1)
+        loop.evaluate(self.eps)
+        self.assertTrue(np.all(np.isnan(loop.get(c.Q.SIGMA)[3:])))
+        loop.update(self.eps)
+        np.testing.assert_array_equal(law.substeps(), [1, 0, 0, 0])
+        np.testing.assert_array_equal(law.kappa()[1:], 0.0)
+
+        loop, law = self.loop(max_iterations=3, max_substeps=64)
+        loop.evaluate(self.eps)
+        self.assertTrue(np.all(np.isfinite(loop.get(c.Q.SIGMA))))
+        loop.update(self.eps)
+        substeps = law.substeps()
+        self.assertEqual(substeps[0], 1)
+        self.assertTrue(np.all(substeps[1:] > 1))
+
+        # the committed states are on the yield surface
+        norm = c.NormVM(self.constraint)
+        sigma = loop.get(c.Q.SIGMA).reshape(4, 3)
+        for ip in range(1, 4):
+            se = norm(sigma[ip])[0]
+            self.assertAlmostEqual(se, self.sig0 + self.H * law.kappa()[ip])
+
+    def test_accuracy(self):
+        """
+        The substepped solution is close to the one of a single step with
+        a converged local Newton method.
+        """
+        reference, _ = self.loop(max_iterations=50, max_substeps=1)
+        reference.evaluate(self.eps)
+
+        loop, law = self.loop(max_iterations=3, max_substeps=64)
+        loop.evaluate(self.eps)
+        sigma, expected = loop.get(c.Q.SIGMA), reference.get(c.Q.SIGMA)
+        self.assertLess(np.linalg.norm(sigma - expected) / np.linalg.norm(expected), 0.05)
+
+    def test_tangent(self):
+        loop, _ = self.loop(max_iterations=20, max_substeps=1)
+        errors = c.check_tangents(loop, self.eps / 10.0, delta=1.0e-8)
+        self.assertLess(np.max(errors.dsigma_deps), 1.0e-6)
+
+    def test_counts_of_update(self):
+        loop, law = self.loop(max_iterations=3, max_substeps=64)
+        loop.update(self.eps)
+        substeps = law.substeps()
+        c.check_tangents(loop, self.eps / 10.0, delta=1.0e-8)
+        loop.evaluate(2.0 * self.eps)
+        np.testing.assert_array_equal(law.substeps(), substeps)
+
+    def test_strain_constraints(self):
+        for constraint in [c.Constraint.PLANE_STRAIN, c.Constraint.UNIAXIAL_STRAIN]:
+            with self.assertRaises(ValueError):
+                c.VonMisesPlasticity(1000.0, 0.3, constraint, self.sig0, self.H)
+
+
+class TestUnits(unittest.TestCase):
+    """
+    The return mapping converges independently of the stress unit.
+    """
+
+    def evaluate(self, unit):
+        constraint = c.Constraint.PLANE_STRESS
+        direction = np.array([1.0, -0.4, 0.7])
+        eps = np.concatenate([f * direction for f in [0.0005, 0.003, 0.01, 0.05]])
+        law = c.VonMisesPlasticity(210000.0 * unit, 0.3, constraint, 355.0 * unit, 1000.0 * unit)
+        loop = c.IpLoop()
+        loop.add_law(law)
+        loop.resize(4)
+        loop.evaluate(eps)
+        sigma, tangent = loop.get(c.Q.SIGMA) / unit, loop.get(c.Q.DSIGMA_DEPS) / unit
+        loop.update(eps)
+        return sigma, tangent, law
+
+    def test_mpa_and_pa(self):
+        sigma, tangent, law = self.evaluate(1.0)
+        sigma_pa, tangent_pa, law_pa = self.evaluate(1.0e6)
+        np.testing.assert_array_equal(law_pa.substeps(), [1, 1, 1, 1])
+        np.testing.assert_allclose(sigma_pa, sigma, rtol=1.0e-10)
+        np.testing.assert_allclose(tangent_pa, tangent, rtol=1.0e-8, atol=1.0e-8 * np.max(np.abs(tangent)))
+        np.testing.assert_allclose(law_pa.kappa(), law.kappa(), rtol=1.0e-10, atol=1.0e-14)
+
+    def test_yield_stress(self):
+        with self.assertRaises(ValueError):
+            c.VonMisesPlasticity(1000.0, 0.3, c.Constraint.PLANE_STRESS, 0.0, 100.0)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,93 @@
+import unittest
+import numpy as np
+import constitutive as c
+
+
+class TestSecantTangent(unittest.TestCase):
+    """
+    The secant tangent of the damage laws is (1 - omega) C, symmetric and
+    positive definite, and does not change the stresses.
+    """
+
+    def setUp(self):
+        self.constraint = c.Constraint.FULL
+        self.n = 20
+        np.random.seed(6174)
+        self.eps = 1.0e-3 * (np.random.random(self.n * 6) - 0.5)
+        self.e = 2.0e-3 * np.random.random(self.n)
+
+    def law(self, law_type):
+        return law_type(
+            20000.0,
+            0.2,
+            self.constraint,
+            c.DamageLawExponential(k0=1.0e-4, alpha=0.99, beta=100.0),
+            c.ModMisesEeq(k=10.0, nu=0.2, constraint=self.constraint),
+        )
+
+    def evaluate(self, law, mode):
+        law.set_tangent_mode(mode)
+        loop = c.IpLoop()
+        loop.add_law(law)
+        loop.resize(self.n)
+        loop.evaluate(self.eps, self.e)
+        return loop
+
+    def check(self, law_type):
+        consistent = self.evaluate(self.law(law_type), c.TangentMode.CONSISTENT)
+        secant = self.evaluate(self.law(law_type), c.TangentMode.SECANT)
+        np.testing.assert_array_equal(secant.get(c.Q.SIGMA), consistent.get(c.Q.SIGMA))
+
+        tangents = secant.get(c.Q.DSIGMA_DEPS).reshape(self.n, 6, 6)
+        stresses = secant.get(c.Q.SIGMA).reshape(self.n, 6)
+        strains = self.eps.reshape(self.n, 6)
+        for tangent, stress, strain in zip(tangents, stresses, strains):
+            np.testing.assert_array_equal(tangent, tangent.T)
+            self.assertGreater(np.min(np.linalg.eigvalsh(tangent)), 0.0)
+            np.testing.assert_allclose(tangent @ strain, stress, atol=1.0e-12)
+        return secant
+
+    def test_local_damage(self):
+        self.check(c.LocalDamage)
+
+    def test_gradient_damage(self):
+        loop = self.check(c.GradientDamage)
+        np.testing.assert_array_equal(loop.get(c.Q.DSIGMA_DE), 0.0)
+        np.testing.assert_array_equal(loop.get(c.Q.DEEQ), 0.0)
+
+    def test_switch(self):
+        law = self.law(c.LocalDamage)
+        loop = self.evaluate(law, c.TangentMode.CONSISTENT)
+        law.set_tangent_mode(c.TangentMode.SECANT)
+        loop.evaluate(self.eps, self.e)
+        tangent = loop.get(c.Q.DSIGMA_DEPS).reshape(self.n, 6, 6)
+        np.testing.assert_array_equal(tangent, tangent.transpose(0, 2, 1))
+
+        law.set_tangent_mode(c.TangentMode.CONSISTENT)
+        loop.evaluate(self.eps, self.e)
+        errors = c.check_tangents(loop, self.eps, delta=1.0e-9)
+        self.assertLess(np.median(errors.dsigma_deps), 1.0e-6)
+
+    def test_packed(self):
+        """
+        In SECANT mode, the tangent is stored packed. Switching back to
+        CONSISTENT after the resize lays out the loop again.
+        """
+        law = self.law(c.LocalDamage)
+        loop = self.evaluate(law, c.TangentMode.SECANT)
+        self.assertEqual(loop.memory()["q"][c.Q.DSIGMA_DEPS], self.n * 21 * 8)
+        sigma = loop.get(c.Q.SIGMA)
+
+        law.set_tangent_mode(c.TangentMode.CONSISTENT)
+        loop.evaluate(self.eps, self.e)
+        self.assertEqual(loop.memory()["q"][c.Q.DSIGMA_DEPS], self.n * 36 * 8)
+        np.testing.assert_array_equal(loop.get(c.Q.SIGMA), sigma)
+        consistent = self.evaluate(self.law(c.LocalDamage), c.TangentMode.CONSISTENT)
+        np.testing.assert_array_equal(loop.get(c.Q.DSIGMA_DEPS), consistent.get(c.Q.DSIGMA_DEPS))
+
+        law.set_tangent_mode(c.TangentMode.SECANT)
+        loop.evaluate(self.eps, self.e)
+        self.assertEqual(loop.memory()["q"][c.Q.DSIGMA_DEPS], self.n * 21 * 8)
+
+if __name__ == "__main__":
+    unittest.main()